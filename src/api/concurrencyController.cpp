@@ -0,0 +1,122 @@
+//------------------------------------------------------------------
+// concurrencyController.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "concurrencyController.h"
+#include "log.h"
+
+#include <string>
+#include <algorithm>
+
+using std::string;
+
+ConcurrencyController::ConcurrencyController(int start, int max) : _limit(std::max(1, std::min(start, max))), _max(std::max(1, max))
+{
+}
+
+void ConcurrencyController::setMax(int max)
+{
+    _max = std::max(1, max);
+    if (_limit > _max)
+        _limit = _max;
+    //the network can have changed since the last batch
+    _minRtt = 0;
+}
+
+void ConcurrencyController::start(curl_off_t bytes)
+{
+    _windowStart = std::chrono::steady_clock::now();
+    _windowBytes = bytes;
+    _rttSum = 0;
+    _rttCount = 0;
+    _congested = false;
+}
+
+void ConcurrencyController::addRtt(double rtt)
+{
+    if (rtt <= 0)
+        return;
+    if (_minRtt <= 0 || rtt < _minRtt)
+        _minRtt = rtt;
+    _rttSum += rtt;
+    _rttCount++;
+}
+
+void ConcurrencyController::onCongestion()
+{
+    if (_congested)
+        return;
+    _congested = true;
+    _hold = CONCURRENCY_HOLD_WINDOWS;
+    setLimit(std::max(1, _limit / 2), "server is overloaded", _lastThroughput, 0);
+}
+
+void ConcurrencyController::update(curl_off_t bytes)
+{
+    auto now = std::chrono::steady_clock::now();
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - _windowStart).count();
+    if (elapsed < CONCURRENCY_WINDOW)
+        return;
+
+    //bytes per second of all transfers together
+    double throughput = (bytes - _windowBytes) * 1000.0 / elapsed;
+    double rtt = _rttCount > 0 ? _rttSum / _rttCount : 0;
+    const bool congested = _congested;
+    start(bytes);
+    if (congested)
+    {
+        //the level has already been lowered in this window
+        _lastLimit = _limit;
+        _lastThroughput = throughput;
+        _increased = false;
+        return;
+    }
+
+    if (rtt > 0 && _minRtt > 0 && rtt > _minRtt * CONCURRENCY_RTT_LIMIT && _limit > 1)
+    {
+        //requests queue up at the server or the access point
+        _hold = CONCURRENCY_HOLD_WINDOWS;
+        setLimit(std::max(1, _limit / 2), "round trip time increased", throughput, rtt);
+    }
+    else if (_increased && _lastLimit < _limit && throughput < _lastThroughput * CONCURRENCY_MIN_GAIN)
+    {
+        //the last added transfer did not help, the link is saturated
+        _hold = CONCURRENCY_HOLD_WINDOWS;
+        setLimit(_lastLimit, "no gain from the last transfer", throughput, rtt);
+        //the old level is measured again before anything is compared with it
+        _lastLimit = _limit;
+        _lastThroughput = 0;
+        _increased = false;
+        return;
+    }
+    else if (_hold == 0 && _limit < _max)
+    {
+        _lastLimit = _limit;
+        _lastThroughput = throughput;
+        setLimit(_limit + 1, "probing", throughput, rtt);
+        _increased = true;
+        return;
+    }
+    else
+    {
+        if (_hold > 0)
+            _hold--;
+        Log::writeInfoLog("Downloads: " + std::to_string(_limit) + " parallel, " + std::to_string(static_cast<long>(throughput / 1024)) + " KB/s, RTT " + std::to_string(static_cast<long>(rtt)) + " ms");
+    }
+
+    _lastLimit = _limit;
+    _lastThroughput = throughput;
+    _increased = false;
+}
+
+void ConcurrencyController::setLimit(int limit, const string &reason, double throughput, double rtt)
+{
+    if (limit == _limit)
+        return;
+    Log::writeInfoLog("Downloads: " + std::to_string(_limit) + " -> " + std::to_string(limit) + " parallel (" + reason + "), " + std::to_string(static_cast<long>(throughput / 1024)) + " KB/s, RTT " + std::to_string(static_cast<long>(rtt)) + " ms");
+    _limit = limit;
+}
@@ -0,0 +1,94 @@
+//------------------------------------------------------------------
+// concurrencyController.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Chooses the number of parallel transfers from the measured throughput (AIMD)
+//
+//-------------------------------------------------------------------
+
+#ifndef CONCURRENCYCONTROLLER
+#define CONCURRENCYCONTROLLER
+
+#include <string>
+#include <chrono>
+#include <curl/curl.h>
+
+//time in ms over which the throughput is measured before the level is changed
+const long CONCURRENCY_WINDOW = 2000;
+//an added transfer has to raise the throughput by this factor, otherwise it is taken back
+const double CONCURRENCY_MIN_GAIN = 1.05;
+//windows the level is kept after a step back before it is probed again
+const int CONCURRENCY_HOLD_WINDOWS = 5;
+//a round trip time above this factor of the lowest one is taken as a sign of congestion
+const double CONCURRENCY_RTT_LIMIT = 2.5;
+
+class ConcurrencyController
+{
+    public:
+        /**
+         * Creates the controller, the level starts at the lower of start and max
+         *
+         * @param start level the transfers start with
+         * @param max highest level
+         */
+        ConcurrencyController(int start, int max);
+
+        /**
+         * Returns the number of transfers that shall run at once
+         */
+        int getLimit() const { return _limit; };
+
+        /**
+         * Sets the highest level before a batch, the current level is lowered if it is above it
+         */
+        void setMax(int max);
+
+        /**
+         * Starts a new window, e.g. at the begin of a batch or while slots stay free as there is nothing left to start
+         *
+         * @param bytes bytes that have been received so far
+         */
+        void start(curl_off_t bytes);
+
+        /**
+         * Measures the throughput and changes the level once a window is over
+         *
+         * @param bytes bytes that have been received so far
+         */
+        void update(curl_off_t bytes);
+
+        /**
+         * Adds the round trip time of a finished transfer, time between sending the request and the first byte
+         *
+         * @param rtt round trip time in ms
+         */
+        void addRtt(double rtt);
+
+        /**
+         * Halves the level as the server rate limits or the connection is overloaded, at most once per window
+         */
+        void onCongestion();
+
+    private:
+        int _limit;
+        int _max;
+        //level and throughput of the last window
+        int _lastLimit = 0;
+        double _lastThroughput = 0;
+        bool _increased = false;
+        int _hold = 0;
+        bool _congested = false;
+
+        std::chrono::steady_clock::time_point _windowStart;
+        curl_off_t _windowBytes = 0;
+        double _minRtt = 0;
+        double _rttSum = 0;
+        int _rttCount = 0;
+
+        /**
+         * Changes the level and logs it
+         */
+        void setLimit(int limit, const std::string &reason, double throughput, double rtt);
+};
+#endif
@@ -11,16 +11,43 @@
 #include "inkview.h"
 #include "fileHandler.h"
 #include "log.h"
+#include "util.h"
 
 #include <string>
-#include <experimental/filesystem>
+#include <unordered_set>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 
 using std::string;
 using std::vector;
 
-namespace fs = std::experimental::filesystem;
+namespace
+{
+    //layout of the records returned by getdents64, older libc versions do not declare it
+    struct LinuxDirent64
+    {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    //the listing of a directory that was changed within this time is not cached, as a further change
+    //in the same timestamp granularity (2s on FAT) would not change the mtime
+    constexpr time_t MTIME_GRANULARITY = 2;
+    constexpr size_t MAX_CACHED_LISTINGS = 1000;
+}
 
 std::shared_ptr<FileHandler> FileBrowser::_fileHandler = std::shared_ptr<FileHandler>(new FileHandler());
+std::unordered_map<std::string, FileBrowser::DirectoryListing> FileBrowser::_listings;
+std::mutex FileBrowser::_listingsMutex;
+
 std::vector<FileItem> FileBrowser::getFileStructure(const std::string &path, const bool includeFiles, const bool includeHeader)
 {
     string localPath = path;
@@ -41,38 +68,178 @@ std::vector<FileItem> FileBrowser::getFileStructure(const std::string &path, con
         items.push_back(temp);
     }
 
-    const int storageLocationLength = _fileHandler->getStorageLocation().length();
-    if (iv_access(localPath.c_str(), R_OK) == 0)
+    int dirFd = open(localPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0)
+        return items;
+
+    struct stat dirStat;
+    if (fstat(dirFd, &dirStat) != 0)
+    {
+        Log::writeErrorLog("Could not stat " + localPath + ": " + strerror(errno));
+        close(dirFd);
+        return items;
+    }
+
+    std::lock_guard<std::mutex> guard(_listingsMutex);
+
+    DirectoryListing uncached;
+    DirectoryListing *listing = nullptr;
+    auto cached = _listings.find(localPath);
+    if (cached != _listings.end() && cached->second.mtime.tv_sec == dirStat.st_mtim.tv_sec && cached->second.mtime.tv_nsec == dirStat.st_mtim.tv_nsec)
+    {
+        listing = &cached->second;
+    }
+    else
+    {
+        if (cached != _listings.end())
+            _listings.erase(cached);
+
+        uncached.mtime = dirStat.st_mtim;
+        if (!readDirectory(dirFd, uncached.entries))
+        {
+            Log::writeErrorLog("Could not read " + localPath + ": " + strerror(errno));
+            close(dirFd);
+            return items;
+        }
+
+        listing = &uncached;
+        if (time(nullptr) - dirStat.st_mtim.tv_sec >= MTIME_GRANULARITY)
+        {
+            if (_listings.size() >= MAX_CACHED_LISTINGS)
+                _listings.clear();
+            listing = &_listings.emplace(localPath, std::move(uncached)).first->second;
+        }
+    }
+
+    //exclusion rules are relative to the storage location
+    const string storageLocation = Util::getConfig<string>("storageLocation") + "/" + _fileHandler->getStorageUsername() + "/";
+    bool insideStorage = localPath.compare(0, storageLocation.length(), storageLocation) == 0;
+    string directoryPath = insideStorage ? localPath.substr(storageLocation.length()) : "";
+
+    for (const DirectoryEntry &entry : listing->entries)
     {
-        for (const auto &entry : fs::directory_iterator(localPath))
+        if (entry.type == Type::FFILE && !includeFiles)
+            continue;
+
+        if (insideStorage)
         {
-            //temp.size = fs::file_size(entry);
-            auto time = std::chrono::system_clock::to_time_t(fs::last_write_time(entry));
-            temp.lastEditDate = *gmtime(&time);
+            if (entry.type == Type::FFOLDER && _fileHandler->excludeFolder(directoryPath + entry.name + "/"))
+                continue;
+            if (entry.type == Type::FFILE && (_fileHandler->excludeFolder(directoryPath) || _fileHandler->excludeFile(entry.name)))
+                continue;
+        }
 
-            string directoryPath = temp.path;
-            if (directoryPath.length() > storageLocationLength + 1) {
-                directoryPath = directoryPath.substr(storageLocationLength + 1);
-            }
-            if(is_directory(entry))
+        //the modification time is read for every returned entry, as it is not part of the cached listing
+        time_t lastEditDate = 0;
+        struct stat entryStat;
+        if (fstatat(dirFd, entry.name.c_str(), &entryStat, 0) == 0)
+            lastEditDate = entryStat.st_mtim.tv_sec;
+
+        temp.path = localPath + entry.name;
+        temp.name = entry.name;
+        temp.type = entry.type;
+        temp.lastEditDate = *gmtime(&lastEditDate);
+        items.push_back(temp);
+    }
+
+    close(dirFd);
+    return items;
+}
+
+void FileBrowser::addLocalItems(std::vector<WebDAVItem> &tempItems, FileHandler &fileHandler)
+{
+    string localPath = tempItems.at(0).localPath + '/';
+    if (iv_access(localPath.c_str(), W_OK) == 0)
+    {
+        vector<FileItem> currentFolder = getFileStructure(localPath,true,false);
+
+        //index the remote items once, so that every local entry is looked up in constant time
+        std::unordered_set<string> remotePaths;
+        remotePaths.reserve(tempItems.size());
+        for (auto it = tempItems.begin() + 1; it != tempItems.end(); ++it)
+            remotePaths.insert(it->localPath);
+
+        const size_t storageLocationLength = fileHandler.getStorageLocation().length();
+        for(const FileItem &local : currentFolder)
+        {
+            //unfinished downloads are not shown as local files
+            if (local.type == Type::FFILE && local.path.length() > 5 && local.path.compare(local.path.length() - 5, 5, ".part") == 0)
+                continue;
+
+            if (remotePaths.find(local.path) == remotePaths.end())
             {
-                temp.path = entry.path();
-                temp.name = temp.path.substr(temp.path.find_last_of('/') + 1, temp.path.length());
-                temp.type = Type::FFOLDER;
-                if (!_fileHandler->excludeFolder(directoryPath + "/")) {
-                    items.push_back(temp);
+                WebDAVItem temp;
+                temp.localPath = local.path;
+                temp.state = FileState::ILOCAL;
+                temp.title = temp.localPath.substr(temp.localPath.find_last_of('/') + 1, temp.localPath.length());
+                //Log::writeInfoLog(std::to_string(fs::file_size(entry)));
+                temp.lastEditDate = local.lastEditDate;
+
+                string directoryPath = temp.localPath;
+                if (directoryPath.length() > storageLocationLength) {
+                    directoryPath = directoryPath.substr(storageLocationLength + 1);
                 }
+                if(local.type == Type::FFOLDER)
+                {
+                    if (fileHandler.excludeFolder(directoryPath + "/")) {
+                        continue;
+                    }
+                    //create new dir in cloud
+                    temp.type = Itemtype::IFOLDER;
+                }
+                else
+                {
+                    //put to cloud
+                    temp.type = Itemtype::IFILE;
+                    if (directoryPath.length() > temp.title.length()) {
+                        directoryPath = directoryPath.substr(0, directoryPath.length() - temp.title.length());
+                    }
+                    if (fileHandler.excludeFolder(directoryPath) || fileHandler.excludeFile(temp.title))
+                    {
+                        continue;
+                    }
+                }
+                tempItems.push_back(temp);
             }
-            else if (includeFiles)
+
+        }
+    }
+}
+
+bool FileBrowser::readDirectory(int dirFd, std::vector<DirectoryEntry> &entries)
+{
+    char buffer[8192];
+    while (true)
+    {
+        long read = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+        if (read < 0)
+            return false;
+        if (read == 0)
+            return true;
+
+        for (long offset = 0; offset < read;)
+        {
+            const LinuxDirent64 *dirent = reinterpret_cast<const LinuxDirent64 *>(buffer + offset);
+            offset += dirent->d_reclen;
+
+            const char *name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            DirectoryEntry entry;
+            entry.name = name;
+
+            unsigned char type = dirent->d_type;
+            if (type == DT_UNKNOWN || type == DT_LNK)
             {
-                temp.path = entry.path();
-                temp.name = temp.path.substr(temp.path.find_last_of('/') + 1, temp.path.length());
-                temp.type = Type::FFILE;
-                if (!_fileHandler->excludeFolder(directoryPath.substr(0, directoryPath.length())) || !_fileHandler->excludeFile(temp.name)) {
-                    items.push_back(temp);
-                }
+                //links are resolved like before
+                struct stat entryStat;
+                if (fstatat(dirFd, name, &entryStat, 0) != 0)
+                    continue;
+                type = S_ISDIR(entryStat.st_mode) ? DT_DIR : DT_REG;
             }
+            entry.type = (type == DT_DIR) ? Type::FFOLDER : Type::FFILE;
+            entries.push_back(std::move(entry));
         }
     }
-    return items;
 }
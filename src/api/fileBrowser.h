@@ -16,16 +16,54 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <ctime>
 
 class FileBrowser
 {
     public:
         static std::vector<FileItem> getFileStructure(const std::string &path, const bool includeFiles, const bool includeHeader);
 
+        /**
+         * Adds the files and folders that only exist locally as ILOCAL items
+         *
+         * @param items items of a folder, the first item is the folder itself
+         * @param fileHandler handler of the calling thread that applies the exclusion rules
+         */
+        static void addLocalItems(std::vector<WebDAVItem> &items, FileHandler &fileHandler);
+
     private:
         FileBrowser(){};
 
+        struct DirectoryEntry
+        {
+            //only name and type are cached, editing a file in place does not change the mtime of the directory
+            std::string name;
+            Type type;
+        };
+
+        struct DirectoryListing
+        {
+            struct timespec mtime;
+            std::vector<DirectoryEntry> entries;
+        };
+
         static std::shared_ptr<FileHandler> _fileHandler;
 
+        //listings of the directories, a directory is only read again if its mtime has changed
+        static std::unordered_map<std::string, DirectoryListing> _listings;
+        static std::mutex _listingsMutex;
+
+        /**
+         * Reads the entries of a directory with getdents64, the type is taken from d_type
+         * and only determined by fstatat if the filesystem does not provide it
+         *
+         * @param dirFd opened directory
+         * @param entries receives the entries without "." and ".."
+         *
+         * @return false if the directory could not be read
+         */
+        static bool readDirectory(int dirFd, std::vector<DirectoryEntry> &entries);
 };
 #endif
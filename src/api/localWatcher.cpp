@@ -0,0 +1,199 @@
+//------------------------------------------------------------------
+// localWatcher.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "localWatcher.h"
+#include "log.h"
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+using std::string;
+using std::vector;
+
+namespace
+{
+    const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+}
+
+LocalWatcher::~LocalWatcher()
+{
+    stop();
+}
+
+bool LocalWatcher::start(const string &root, vector<string> &existing)
+{
+    stop();
+
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0)
+    {
+        Log::writeErrorLog("Could not initialize inotify: " + string(strerror(errno)));
+        return false;
+    }
+
+    _complete = true;
+    addWatches(root, existing);
+
+    _rootWatch = -1;
+    for (const auto &watch : _watches)
+    {
+        if (watch.second == root)
+            _rootWatch = watch.first;
+    }
+    if (_rootWatch < 0)
+        _complete = false;
+
+    Log::writeInfoLog("Watching " + std::to_string(_watches.size()) + " folders below " + root + (_complete ? "" : ", not all changes can be recorded"));
+    return _complete;
+}
+
+void LocalWatcher::stop()
+{
+    if (_fd >= 0)
+        close(_fd);
+    _fd = -1;
+    _complete = false;
+    _rootWatch = -1;
+    _watches.clear();
+}
+
+bool LocalWatcher::poll(vector<LocalChange> &changes)
+{
+    //nothing is watched, so nothing can be lost
+    if (_fd < 0)
+        return true;
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool lost = false;
+    while (true)
+    {
+        ssize_t length = read(_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                lost = true;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED)
+            {
+                _watches.erase(event->wd);
+                continue;
+            }
+
+            if (event->wd == _rootWatch && (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)))
+            {
+                lost = true;
+                continue;
+            }
+
+            auto watch = _watches.find(event->wd);
+            if (watch == _watches.end() || event->len == 0)
+                continue;
+
+            string path = watch->second + "/" + event->name;
+            if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE))
+            {
+                changes.push_back({path, true});
+                //the content of a moved in folder or created before the watch was added is not reported
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                {
+                    vector<string> found;
+                    addWatches(path, found);
+                    for (auto &foundPath : found)
+                        changes.push_back({std::move(foundPath), true});
+                }
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                changes.push_back({path, false});
+                //the watches of a moved folder would report their old path
+                if ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM))
+                    removeWatches(path);
+            }
+        }
+    }
+
+    if (lost)
+        _complete = false;
+    return !lost;
+}
+
+void LocalWatcher::addWatches(const string &path, vector<string> &found)
+{
+    int watch = inotify_add_watch(_fd, path.c_str(), WATCH_MASK);
+    if (watch < 0)
+    {
+        //a folder that has been removed in the meantime does not need to be watched
+        if (errno == ENOENT || errno == ENOTDIR)
+            return;
+        if (errno == ENOSPC)
+            Log::writeErrorLog("Could not watch " + path + ", the limit of inotify watches is reached");
+        else
+            Log::writeErrorLog("Could not watch " + path + ": " + strerror(errno));
+        _complete = false;
+        return;
+    }
+    _watches[watch] = path;
+
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+        return;
+
+    vector<string> folders;
+    while (struct dirent *entry = readdir(dir))
+    {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        string entryPath = path + "/" + name;
+        bool isFolder = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            struct stat entryStat;
+            isFolder = lstat(entryPath.c_str(), &entryStat) == 0 && S_ISDIR(entryStat.st_mode);
+        }
+        if (isFolder)
+            folders.push_back(entryPath);
+        found.push_back(std::move(entryPath));
+    }
+    closedir(dir);
+
+    for (const auto &folder : folders)
+        addWatches(folder, found);
+}
+
+void LocalWatcher::removeWatches(const string &path)
+{
+    const string prefix = path + "/";
+    for (auto watch = _watches.begin(); watch != _watches.end();)
+    {
+        if (watch->second == path || watch->second.compare(0, prefix.length(), prefix) == 0)
+        {
+            inotify_rm_watch(_fd, watch->first);
+            watch = _watches.erase(watch);
+        }
+        else
+        {
+            ++watch;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+//------------------------------------------------------------------
+// localWatcher.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Watches the storage location with inotify to record local changes
+//
+//-------------------------------------------------------------------
+
+#ifndef LOCALWATCHER
+#define LOCALWATCHER
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * A path below the storage location that has been created, changed or removed
+ */
+struct LocalChange
+{
+    std::string localPath;
+    bool exists;
+};
+
+class LocalWatcher
+{
+    public:
+        LocalWatcher() = default;
+
+        ~LocalWatcher();
+
+        LocalWatcher(const LocalWatcher &) = delete;
+        LocalWatcher &operator=(const LocalWatcher &) = delete;
+
+        /**
+         * Watches every folder below root, a running watch is stopped before
+         *
+         * @param root folder that shall be watched
+         * @param existing receives every file and folder that exists below root
+         * @return true if all folders are watched, otherwise changes can be missed and the files have to be checked
+         */
+        bool start(const std::string &root, std::vector<std::string> &existing);
+
+        void stop();
+
+        /**
+         * Reads the pending events without blocking
+         *
+         * @param changes receives the changed paths, folders created later are watched as well
+         * @return false if events have been lost and everything has to be scanned again
+         */
+        bool poll(std::vector<LocalChange> &changes);
+
+        /**
+         * Returns true if every change below the root is recorded since the last start
+         */
+        bool isComplete() const { return _fd >= 0 && _complete; };
+
+    private:
+        int _fd = -1;
+        bool _complete = false;
+        int _rootWatch = -1;
+        std::unordered_map<int, std::string> _watches;
+
+        /**
+         * Watches the folder and all folders below it
+         *
+         * @param path folder that shall be watched
+         * @param found receives the path of every file and folder below path
+         */
+        void addWatches(const std::string &path, std::vector<std::string> &found);
+
+        /**
+         * Removes the watches of the folder and all folders below it
+         */
+        void removeWatches(const std::string &path);
+};
+#endif
@@ -0,0 +1,223 @@
+//------------------------------------------------------------------
+// propfindParser.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "propfindParser.h"
+
+#include <string>
+#include <cstring>
+
+using std::string;
+
+PropfindParser::PropfindParser(std::function<void(const PropfindResponse &)> onResponse, std::function<void()> onReset) : _onResponse(onResponse), _onReset(onReset)
+{
+}
+
+bool PropfindParser::reset()
+{
+    if (_responses > 0 && _onResponse)
+    {
+        if (!_onReset)
+            return false;
+        _onReset();
+    }
+
+    _current = PropfindResponse();
+    _state = State::TEXT;
+    _quote = 0;
+    _tag.clear();
+    _specialEnd.clear();
+    _target = nullptr;
+    _syncToken.clear();
+    _inResponse = false;
+    _inPropstat = false;
+    _parsedBytes = 0;
+    _responses = 0;
+    return true;
+}
+
+size_t PropfindParser::writeCallback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    static_cast<PropfindParser *>(userp)->feed(static_cast<const char *>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+void PropfindParser::feed(const char *data, size_t length)
+{
+    const char *end = data + length;
+    _parsedBytes += length;
+    while (data < end)
+    {
+        switch (_state)
+        {
+            case State::TEXT:
+                {
+                    //copy only the text of the elements that are of interest
+                    const char *open = static_cast<const char *>(memchr(data, '<', end - data));
+                    const char *textEnd = open ? open : end;
+                    if (_target)
+                        _target->append(data, textEnd - data);
+                    data = textEnd;
+                    if (open)
+                    {
+                        _tag.clear();
+                        _state = State::TAG;
+                        data++;
+                    }
+                    break;
+                }
+            case State::TAG:
+                {
+                    char c = *data++;
+                    if (c == '>')
+                    {
+                        _state = State::TEXT;
+                        handleTag();
+                    }
+                    else if (c == '"' || c == '\'')
+                    {
+                        _quote = c;
+                        _state = State::QUOTE;
+                    }
+                    else
+                    {
+                        _tag.push_back(c);
+                        if (_tag == "!--")
+                        {
+                            _specialEnd = "-->";
+                            _state = State::SPECIAL;
+                        }
+                        else if (_tag == "![CDATA[")
+                        {
+                            _specialEnd = "]]>";
+                            _state = State::SPECIAL;
+                        }
+                    }
+                    break;
+                }
+            case State::QUOTE:
+                {
+                    //attribute values are not needed
+                    const char *close = static_cast<const char *>(memchr(data, _quote, end - data));
+                    if (close)
+                    {
+                        data = close + 1;
+                        _state = State::TAG;
+                    }
+                    else
+                    {
+                        data = end;
+                    }
+                    break;
+                }
+            case State::SPECIAL:
+                {
+                    _tag.push_back(*data++);
+                    if (_tag.length() >= _specialEnd.length() + 3 && _tag.compare(_tag.length() - _specialEnd.length(), _specialEnd.length(), _specialEnd) == 0)
+                    {
+                        if (_target && _specialEnd == "]]>")
+                            _target->append(_tag, 8, _tag.length() - 8 - _specialEnd.length());
+                        _state = State::TEXT;
+                    }
+                    break;
+                }
+        }
+    }
+}
+
+void PropfindParser::handleTag()
+{
+    if (_tag.empty() || _tag[0] == '?' || _tag[0] == '!')
+        return;
+
+    bool closing = _tag[0] == '/';
+    bool selfClosing = !closing && _tag.back() == '/';
+
+    size_t nameBegin = closing ? 1 : 0;
+    size_t nameEnd = _tag.find_first_of(" \t\r\n/", nameBegin);
+    if (nameEnd == string::npos)
+        nameEnd = _tag.length();
+
+    //namespace prefixes can be chosen freely by the server, only the local name is compared
+    size_t colon = _tag.rfind(':', nameEnd);
+    if (colon != string::npos && colon >= nameBegin)
+        nameBegin = colon + 1;
+    const char *name = _tag.c_str() + nameBegin;
+    size_t nameLength = nameEnd - nameBegin;
+    auto is = [name, nameLength](const char *localName) {
+        return strlen(localName) == nameLength && strncmp(name, localName, nameLength) == 0;
+    };
+
+    if (closing)
+    {
+        _target = nullptr;
+        if (is("propstat"))
+        {
+            _inPropstat = false;
+        }
+        else if (_inResponse && is("response"))
+        {
+            _inResponse = false;
+            _responses++;
+            if (_onResponse)
+                _onResponse(_current);
+        }
+        return;
+    }
+
+    if (is("response"))
+    {
+        _current = PropfindResponse();
+        _inResponse = true;
+        _inPropstat = false;
+        _target = nullptr;
+        return;
+    }
+
+    if (!_inResponse)
+    {
+        if (!selfClosing && is("sync-token"))
+        {
+            _target = &_syncToken;
+            _target->clear();
+        }
+        return;
+    }
+
+    if (is("propstat"))
+    {
+        _inPropstat = true;
+        return;
+    }
+
+    if (is("collection"))
+    {
+        _current.collection = true;
+        return;
+    }
+
+    if (selfClosing)
+        return;
+
+    if (is("href"))
+        _target = &_current.href;
+    else if (is("getetag"))
+        _target = &_current.etag;
+    else if (is("getlastmodified"))
+        _target = &_current.lastModified;
+    else if (is("getcontenttype"))
+        _target = &_current.contentType;
+    else if (is("size") || is("getcontentlength"))
+        _target = &_current.size;
+    else if (is("status") && !_inPropstat)
+        _target = &_current.status;
+    else
+        _target = nullptr;
+
+    if (_target)
+        _target->clear();
+}
@@ -0,0 +1,102 @@
+//------------------------------------------------------------------
+// propfindParser.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Streaming parser for WebDAV multistatus responses
+//
+//-------------------------------------------------------------------
+
+#ifndef PROPFINDPARSER
+#define PROPFINDPARSER
+
+#include <string>
+#include <functional>
+
+/**
+ * Properties of one <response> element of a multistatus
+ */
+struct PropfindResponse
+{
+    std::string href;
+    std::string etag;
+    std::string lastModified;
+    std::string contentType;
+    std::string size;
+    //status of the response itself (e.g. 404 for members removed since the last sync-token)
+    std::string status;
+    bool collection = false;
+};
+
+class PropfindParser
+{
+    public:
+        /**
+         * Creates a parser that calls onResponse for every complete <response> element
+         *
+         * @param onResponse callback that receives the parsed response
+         * @param onReset callback that discards the responses received so far if the request is repeated
+         */
+        PropfindParser(std::function<void(const PropfindResponse &)> onResponse = nullptr, std::function<void()> onReset = nullptr);
+
+        /**
+         * Prepares the parser for a repeated request
+         *
+         * @return false if responses have been handed over that cannot be discarded
+         */
+        bool reset();
+
+        /**
+         * Parses the next part of the document, the chunks can be split at any position
+         *
+         * @param data pointer to the chunk
+         * @param length length of the chunk
+         */
+        void feed(const char *data, size_t length);
+
+        /**
+         * Curl write callback that feeds the received data into the parser
+         *
+         * @param userp pointer to the PropfindParser
+         */
+        static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp);
+
+        /**
+         * Returns the sync-token of a sync-collection report (RFC 6578)
+         */
+        const std::string &getSyncToken() const { return _syncToken; };
+
+        /**
+         * Returns the number of bytes that have been parsed, after curl has decoded the content
+         */
+        size_t getParsedBytes() const { return _parsedBytes; };
+
+    private:
+        enum class State
+        {
+            TEXT,
+            TAG,
+            QUOTE,
+            SPECIAL
+        };
+
+        std::function<void(const PropfindResponse &)> _onResponse;
+        std::function<void()> _onReset;
+        size_t _responses = 0;
+        PropfindResponse _current;
+        State _state = State::TEXT;
+        char _quote = 0;
+        std::string _tag;
+        std::string _specialEnd;
+        std::string *_target = nullptr;
+        std::string _syncToken;
+        bool _inResponse = false;
+        bool _inPropstat = false;
+        size_t _parsedBytes = 0;
+
+        /**
+         * Handles a complete tag without the surrounding brackets
+         */
+        void handleTag();
+};
+#endif
@@ -0,0 +1,238 @@
+//------------------------------------------------------------------
+// retryPolicy.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "retryPolicy.h"
+#include "log.h"
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+#include <strings.h>
+
+using std::string;
+
+namespace
+{
+    struct CircuitState
+    {
+        int failures = 0;
+        std::chrono::steady_clock::time_point openUntil;
+    };
+
+    //the worker and the UI each have their own connection, the state of the server is shared
+    std::mutex &circuitMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::map<string, CircuitState> &circuits()
+    {
+        static std::map<string, CircuitState> states;
+        return states;
+    }
+}
+
+RetryPolicy::RetryPolicy(const string &server) : _server(server), _random(std::random_device()())
+{
+}
+
+RequestError RetryPolicy::classify(CURLcode res, long responseCode, bool cancelled)
+{
+    switch (res)
+    {
+        case CURLE_OK:
+            break;
+        case CURLE_ABORTED_BY_CALLBACK:
+            return cancelled ? RequestError::ICANCELLED : RequestError::IFATAL;
+        case CURLE_COULDNT_RESOLVE_PROXY:
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_HTTP2:
+            return RequestError::INETWORK;
+        case CURLE_RANGE_ERROR:
+            return RequestError::IRANGE;
+        default:
+            return RequestError::IFATAL;
+    }
+
+    switch (responseCode)
+    {
+        case 401:
+            return RequestError::IAUTH;
+        case 404:
+            return RequestError::INOTFOUND;
+        case 416:
+            return RequestError::IRANGE;
+        case 408:
+        case 429:
+        case 502:
+        case 503:
+        case 504:
+            return RequestError::IUNAVAILABLE;
+        default:
+            return responseCode >= 400 ? RequestError::IREJECTED : RequestError::INONE;
+    }
+}
+
+bool RetryPolicy::isTransient(RequestError error)
+{
+    return error == RequestError::INETWORK || error == RequestError::IUNAVAILABLE || error == RequestError::IRANGE;
+}
+
+string RetryPolicy::describe(RequestError error)
+{
+    switch (error)
+    {
+        case RequestError::INETWORK:
+            return "network error";
+        case RequestError::IUNAVAILABLE:
+            return "server unavailable";
+        case RequestError::IRANGE:
+            return "download could not be resumed";
+        case RequestError::IAUTH:
+            return "username/password incorrect";
+        case RequestError::INOTFOUND:
+            return "not found";
+        case RequestError::IREJECTED:
+            return "rejected by the server";
+        case RequestError::IFATAL:
+            return "connection error";
+        case RequestError::ICANCELLED:
+            return "cancelled";
+        default:
+            return "no error";
+    }
+}
+
+bool RetryPolicy::allowRequest()
+{
+    std::lock_guard<std::mutex> lock(circuitMutex());
+    auto circuit = circuits().find(_server);
+    if (circuit == circuits().end() || circuit->second.failures < CIRCUIT_THRESHOLD)
+        return true;
+    //once the time is over requests are sent again, there is no limit to a single probe
+    //the failures are still counted, so the first transient failure opens the circuit again and the first success closes it
+    return std::chrono::steady_clock::now() >= circuit->second.openUntil;
+}
+
+void RetryPolicy::recordResult(RequestError error)
+{
+    if (error == RequestError::ICANCELLED)
+        return;
+
+    std::lock_guard<std::mutex> lock(circuitMutex());
+    CircuitState &circuit = circuits()[_server];
+    //the server has answered, only the part file was wrong
+    if (!isTransient(error) || error == RequestError::IRANGE)
+    {
+        circuit.failures = 0;
+        return;
+    }
+
+    circuit.failures++;
+    if (circuit.failures >= CIRCUIT_THRESHOLD)
+    {
+        circuit.openUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(CIRCUIT_OPEN_TIME);
+        Log::writeErrorLog("No requests are sent to " + _server + " for " + std::to_string(CIRCUIT_OPEN_TIME / 1000) + " s after " + std::to_string(circuit.failures) + " failed attempts");
+    }
+}
+
+long RetryPolicy::getDelay(int attempt, long retryAfter)
+{
+    if (attempt >= RETRY_MAX_ATTEMPTS || retryAfter > RETRY_AFTER_LIMIT)
+        return -1;
+
+    //full jitter, so that clients that failed at the same time do not retry at the same time
+    long limit = std::min(RETRY_MAX_DELAY, RETRY_BASE_DELAY << (attempt - 1));
+    long delay = std::uniform_int_distribution<long>(0, limit)(_random);
+    return std::max(delay, retryAfter);
+}
+
+bool RetryPolicy::waitForRetry(int attempt, long retryAfter, const std::atomic<bool> *cancel)
+{
+    long delay = getDelay(attempt, retryAfter);
+    if (delay < 0)
+        return false;
+
+    Log::writeInfoLog("Retrying request in " + std::to_string(delay) + " ms (attempt " + std::to_string(attempt + 1) + " of " + std::to_string(RETRY_MAX_ATTEMPTS) + ")");
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        if (cancel && cancel->load())
+            return false;
+        std::this_thread::sleep_for(std::min(std::chrono::milliseconds(100), std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now())));
+    }
+    return !(cancel && cancel->load());
+}
+
+long RetryPolicy::parseRetryAfter(const string &header)
+{
+    const string name = "Retry-After:";
+    if (header.length() <= name.length() || strncasecmp(header.c_str(), name.c_str(), name.length()) != 0)
+        return -1;
+
+    string value = header.substr(name.length());
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r\n") + 1);
+    if (value.empty())
+        return -1;
+
+    //long has 32 bit on the device, every delay above the limit is treated the same, so the seconds are clamped before they are converted
+    const long long maxSeconds = RETRY_AFTER_LIMIT / 1000 + 1;
+    if (value.find_first_not_of("0123456789") == string::npos)
+        return std::min(atoll(value.substr(0, 18).c_str()), maxSeconds) * 1000;
+
+    time_t date = curl_getdate(value.c_str(), NULL);
+    if (date < 0)
+        return -1;
+    return std::max(0LL, std::min(static_cast<long long>(date) - time(NULL), maxSeconds)) * 1000;
+}
+
+void ErrorReport::add(RequestError error, const string &request)
+{
+    _counts[error]++;
+    if (_examples.size() < 3)
+        _examples.push_back(request + " (" + RetryPolicy::describe(error) + ")");
+}
+
+void ErrorReport::clear()
+{
+    _counts.clear();
+    _examples.clear();
+}
+
+string ErrorReport::summary() const
+{
+    int total = 0;
+    string classes;
+    for (const auto &count : _counts)
+    {
+        total += count.second;
+        if (!classes.empty())
+            classes += ", ";
+        classes += std::to_string(count.second) + "x " + RetryPolicy::describe(count.first);
+    }
+
+    string text = std::to_string(total) + (total == 1 ? " request" : " requests") + " failed: " + classes;
+    for (const auto &example : _examples)
+        text += "\n" + example;
+    if (total > static_cast<int>(_examples.size()))
+        text += "\n...";
+    return text;
+}
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------
+// retryPolicy.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Classifies failed requests, spaces out retries and stops them while a server is unreachable
+//
+//-------------------------------------------------------------------
+
+#ifndef RETRYPOLICY
+#define RETRYPOLICY
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <random>
+#include <curl/curl.h>
+
+//attempts of a request including the first one
+const int RETRY_MAX_ATTEMPTS = 4;
+//the delay before the n-th retry is picked randomly below RETRY_BASE_DELAY * 2^(n-1), at most RETRY_MAX_DELAY ms
+const long RETRY_BASE_DELAY = 500;
+const long RETRY_MAX_DELAY = 8000;
+//a server that asks to wait longer than this is not retried during the running batch
+const long RETRY_AFTER_LIMIT = 60000;
+//transient failures in a row after which no requests are sent to the server for CIRCUIT_OPEN_TIME ms
+const int CIRCUIT_THRESHOLD = 5;
+const long CIRCUIT_OPEN_TIME = 30000;
+
+enum class RequestError
+{
+    INONE,
+    //timeouts, resets and failed connects, e.g. during a Wi-Fi handover
+    INETWORK,
+    //the server is overloaded or rate limits (408, 429, 502, 503, 504)
+    IUNAVAILABLE,
+    //the part file of a resumed download does not fit the file on the server (416), it is downloaded again from the start
+    IRANGE,
+    //credentials have been rejected (401)
+    IAUTH,
+    INOTFOUND,
+    //all other responses >= 400, their meaning depends on the request
+    IREJECTED,
+    //certificate errors and other failures that do not go away by repeating the request
+    IFATAL,
+    ICANCELLED
+};
+
+class RetryPolicy
+{
+    public:
+        /**
+         * Creates the policy for requests to one server, the circuit breaker is shared by all policies of the server
+         *
+         * @param server url of the server
+         */
+        RetryPolicy(const std::string &server = "");
+
+        /**
+         * Maps the result of curl and the response code to an error class
+         *
+         * @param res result of curl
+         * @param responseCode response code of the server, only used if res is CURLE_OK
+         * @param cancelled true if the request has been aborted by the user
+         */
+        static RequestError classify(CURLcode res, long responseCode, bool cancelled);
+
+        /**
+         * Returns true if the same request can succeed if it is sent again later
+         */
+        static bool isTransient(RequestError error);
+
+        /**
+         * Returns a short description of the error class for the user
+         */
+        static std::string describe(RequestError error);
+
+        /**
+         * Returns false while the circuit breaker of the server is open
+         */
+        bool allowRequest();
+
+        /**
+         * Counts transient failures in a row to open the circuit breaker, every other result closes it
+         */
+        void recordResult(RequestError error);
+
+        /**
+         * Waits before the next attempt
+         *
+         * @param attempt attempts that have been made
+         * @param retryAfter delay the server asked for in ms, -1 if it did not send Retry-After
+         * @param cancel the wait is aborted once it is set
+         * @return false if no further attempt shall be made
+         */
+        bool waitForRetry(int attempt, long retryAfter, const std::atomic<bool> *cancel);
+
+        /**
+         * Returns the delay before the next attempt in ms, -1 if no further attempt shall be made
+         *
+         * @param attempt attempts that have been made
+         * @param retryAfter delay the server asked for in ms, -1 if it did not send Retry-After
+         */
+        long getDelay(int attempt, long retryAfter);
+
+        /**
+         * Parses a Retry-After header line into ms, the value can be seconds or a HTTP date
+         *
+         * @param header complete header line
+         * @return delay in ms or -1 if the line is no Retry-After header
+         */
+        static long parseRetryAfter(const std::string &header);
+
+    private:
+        std::string _server;
+        std::mt19937 _random;
+};
+
+/**
+ * Collects the failed requests of a batch so that they can be shown at once
+ */
+class ErrorReport
+{
+    public:
+        void add(RequestError error, const std::string &request);
+
+        bool empty() const { return _counts.empty(); };
+
+        void clear();
+
+        /**
+         * Returns the failures grouped by class, e.g. "3 requests failed: 2x network error, 1x not found"
+         */
+        std::string summary() const;
+
+    private:
+        std::map<RequestError, int> _counts;
+        //the first requests are named in the summary
+        std::vector<std::string> _examples;
+};
+#endif
@@ -16,7 +16,9 @@
 
 #include <string>
 #include <vector>
-#include <regex>
+#include <chrono>
+#include <unordered_map>
+#include <set>
 
 using std::string;
 
@@ -24,6 +26,9 @@ SqliteConnector::SqliteConnector(const string &DBpath) : _dbpath(DBpath)
 {
      _fileHandler = std::shared_ptr<FileHandler>(new FileHandler());
 
+    if (!open())
+        return;
+
      // check if migration has to be run
     int currentVersion = getDbVersion();
     if (currentVersion != DBVERSION) {
@@ -33,26 +38,75 @@ SqliteConnector::SqliteConnector(const string &DBpath) : _dbpath(DBpath)
 
 SqliteConnector::~SqliteConnector()
 {
+    for (auto &statement : _statements)
+        sqlite3_finalize(statement.second);
+    _statements.clear();
+
     sqlite3_close(_db);
     _fileHandler.reset();
     Log::writeInfoLog("closed DB");
 }
 
+sqlite3_stmt *SqliteConnector::getStatement(const string &sql)
+{
+    auto cached = _statements.find(sql);
+    if (cached != _statements.end())
+    {
+        sqlite3_reset(cached->second);
+        sqlite3_clear_bindings(cached->second);
+        return cached->second;
+    }
+
+    sqlite3_stmt *stmt = 0;
+    int rs = sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, 0);
+    if (rs != SQLITE_OK)
+    {
+        Log::writeErrorLog("Could not prepare " + sql + ": " + sqlite3_errmsg(_db) + " (Error Code: " + std::to_string(rs) + ")");
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    _statements.emplace(sql, stmt);
+    return stmt;
+}
+
 void SqliteConnector::runMigration(int currentVersion) 
 {
-    open();
+    Log::writeInfoLog("Running migration from db version " + std::to_string(currentVersion) + " to " + std::to_string(DBVERSION) + " (Program version " + PROGRAMVERSION + ")");
+
+    if (currentVersion < 3)
+    {
+        // etag of the locally saved version for conditional downloads
+        sqlite3_exec(_db, "ALTER TABLE metadata ADD localEtag VARCHAR DEFAULT '' NOT NULL", NULL, 0, NULL);
+    }
+
+    if (currentVersion < 4)
+    {
+        createIndexes();
+    }
+
+    if (currentVersion < 5)
+    {
+        // the hide states are evaluated again in the background for the current rules
+        sqlite3_exec(_db, "ALTER TABLE metadata ADD hideVersion INT DEFAULT 0 NOT NULL", NULL, 0, NULL);
+    }
 
-    char* log;
-    sprintf(log, "Running migration from db version %i to %i (Program version %s)", currentVersion, DBVERSION, PROGRAMVERSION);
-    Log::writeInfoLog(log);
+    if (currentVersion < 6)
+    {
+        // local changes are matched by the local path
+        createIndexes();
+    }
 
-    // currently there are no migrations
+    if (currentVersion < 7)
+    {
+        // the transfers are read in the order they are downloaded
+        createIndexes();
+    }
 
     // updating to current version
     int rs;
     sqlite3_stmt *stmt = 0;
 
-    rs = sqlite3_prepare_v2(_db, "INSERT INTO 'version' (dbversion) VALUES (?)", -1, &stmt, 0);
+    stmt = getStatement("INSERT INTO 'version' (dbversion) VALUES (?)");
     rs = sqlite3_bind_int(stmt, 1, DBVERSION);
 
     rs = sqlite3_step(stmt);
@@ -61,46 +115,41 @@ void SqliteConnector::runMigration(int currentVersion)
         Log::writeErrorLog(std::string("error inserting into version") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+    sqlite3_reset(stmt);
 }
 
 int SqliteConnector::getDbVersion() 
 {
-    open();
-
     int rs;
     sqlite3_stmt *stmt = 0;
     
-    int version;
-    rs = sqlite3_prepare_v2(_db, "SELECT MAX(dbversion) FROM 'version'", -1, &stmt, 0);
+    int version = 0;
+    stmt = getStatement("SELECT MAX(dbversion) FROM 'version'");
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
         version = sqlite3_column_int(stmt, 0);
     }
+    sqlite3_reset(stmt);
 
     if (version != 0)
     {
-        sqlite3_finalize(stmt);
-        sqlite3_close(_db);
         return version;
     } else {
         // this is probably the first start -> the version is up to date and insert the current version
-        rs = sqlite3_prepare_v2(_db, "INSERT INTO 'version' (dbversion) VALUES (?)", -1, &stmt, 0);
+        stmt = getStatement("INSERT INTO 'version' (dbversion) VALUES (?)");
         rs = sqlite3_bind_int(stmt, 1, DBVERSION);
 
         rs = sqlite3_step(stmt);
         if (rs != SQLITE_DONE) {
             Log::writeErrorLog(std::string("error inserting into version") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
         }
-        rs = sqlite3_clear_bindings(stmt);
-        rs = sqlite3_reset(stmt);
+        sqlite3_reset(stmt);
 
         // for compatibility alter the table because at this point db migrations doesn't exist
         rs = sqlite3_exec(_db, "ALTER TABLE metadata ADD hide INT DEFAULT 0 NOT NULL", NULL, 0, NULL);
-
-        sqlite3_finalize(stmt);
-        sqlite3_close(_db);
+        rs = sqlite3_exec(_db, "ALTER TABLE metadata ADD localEtag VARCHAR DEFAULT '' NOT NULL", NULL, 0, NULL);
+        rs = sqlite3_exec(_db, "ALTER TABLE metadata ADD hideVersion INT DEFAULT 0 NOT NULL", NULL, 0, NULL);
+        createIndexes();
 
         return DBVERSION;
     }
@@ -108,6 +157,9 @@ int SqliteConnector::getDbVersion()
 
 bool SqliteConnector::open()
 {
+    if (_db)
+        return true;
+
     int rs;
 
     rs = sqlite3_open(_dbpath.c_str(), &_db);
@@ -115,26 +167,86 @@ bool SqliteConnector::open()
     if (rs)
     {
         Log::writeErrorLog("Could not open DB at " + _dbpath);
+        sqlite3_close(_db);
+        _db = nullptr;
         return false;
     }
 
-    rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS metadata (title VARCHAR, localPath VARCHAR, size VARCHAR, fileType VARCHAR, lasteditDate VARCHAR, type INT, state INT, etag VARCHAR, path VARCHAR PRIMARY KEY, parentPath VARCHAR, hide INT DEFAULT 0 NOT NULL)", NULL, 0, NULL);
+    // WAL avoids rewriting the rollback journal on every commit, NORMAL is still safe in WAL mode
+    sqlite3_stmt *stmt = 0;
+    rs = sqlite3_prepare_v2(_db, "PRAGMA journal_mode=WAL;", -1, &stmt, 0);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        string journalMode = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        if (journalMode != "wal")
+            Log::writeInfoLog("Could not switch DB to WAL, using journal mode " + journalMode);
+    }
+    sqlite3_finalize(stmt);
+    rs = sqlite3_exec(_db, "PRAGMA synchronous=NORMAL;", NULL, 0, NULL);
+    // the sync worker uses its own connection, writes of the other connection are waited for
+    sqlite3_busy_timeout(_db, 5000);
+    // 4 MB page cache, 16 MB memory mapped reads and temporary tables in memory
+    rs = sqlite3_exec(_db, "PRAGMA cache_size=-4096;", NULL, 0, NULL);
+    rs = sqlite3_exec(_db, "PRAGMA mmap_size=16777216;", NULL, 0, NULL);
+    rs = sqlite3_exec(_db, "PRAGMA temp_store=MEMORY;", NULL, 0, NULL);
+
+    rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS metadata (title VARCHAR, localPath VARCHAR, size VARCHAR, fileType VARCHAR, lasteditDate VARCHAR, type INT, state INT, etag VARCHAR, path VARCHAR PRIMARY KEY, parentPath VARCHAR, hide INT DEFAULT 0 NOT NULL, localEtag VARCHAR DEFAULT '' NOT NULL, hideVersion INT DEFAULT 0 NOT NULL)", NULL, 0, NULL);
     rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS version (dbversion INT)", NULL, 0, NULL);
+    rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS syncToken (path VARCHAR PRIMARY KEY, token VARCHAR)", NULL, 0, NULL);
+    rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS localJournal (localPath VARCHAR PRIMARY KEY, present INT)", NULL, 0, NULL);
+    rs = sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS transferQueue (path VARCHAR PRIMARY KEY, priority INT, folder VARCHAR DEFAULT '' NOT NULL, attempts INT DEFAULT 0 NOT NULL)", NULL, 0, NULL);
 
     return true;
 }
 
-string SqliteConnector::getEtag(const string &path)
+void SqliteConnector::createIndexes()
 {
-    open();
+    int rs;
+
+    // the primary key on path already serves the path prefix ranges
+    rs = sqlite3_exec(_db, "CREATE INDEX IF NOT EXISTS metadata_parentPath ON metadata (parentPath)", NULL, 0, NULL);
+    if (rs != SQLITE_OK)
+    {
+        Log::writeErrorLog(std::string("error creating index ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    rs = sqlite3_exec(_db, "CREATE INDEX IF NOT EXISTS metadata_localPath ON metadata (localPath)", NULL, 0, NULL);
+    if (rs != SQLITE_OK)
+    {
+        Log::writeErrorLog(std::string("error creating index ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    rs = sqlite3_exec(_db, "CREATE INDEX IF NOT EXISTS transferQueue_priority ON transferQueue (priority DESC)", NULL, 0, NULL);
+    if (rs != SQLITE_OK)
+    {
+        Log::writeErrorLog(std::string("error creating index ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    rs = sqlite3_exec(_db, "ANALYZE metadata", NULL, 0, NULL);
+}
+
+string SqliteConnector::getPrefixEnd(string prefix)
+{
+    // smallest string that is greater than all strings starting with prefix
+    while (!prefix.empty())
+    {
+        unsigned char last = prefix.back();
+        prefix.pop_back();
+        if (last < 0xFF)
+        {
+            prefix.push_back(static_cast<char>(last + 1));
+            return prefix;
+        }
+    }
+    return prefix;
+}
 
+string SqliteConnector::getEtag(const string &path)
+{
     int rs;
     sqlite3_stmt *stmt = 0;
     std::vector<WebDAVItem> items;
     string etag = "not found";
 
 
-    rs = sqlite3_prepare_v2(_db, "SELECT etag FROM 'metadata' WHERE path = ? LIMIT 1;", -1, &stmt, 0);
+    stmt = getStatement("SELECT etag FROM 'metadata' WHERE path = ? LIMIT 1;");
     rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
 
     while (sqlite3_step(stmt) == SQLITE_ROW)
@@ -142,21 +254,56 @@ string SqliteConnector::getEtag(const string &path)
         etag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+    sqlite3_reset(stmt);
     return etag;
 }
 
-FileState SqliteConnector::getState(const string &path)
+string SqliteConnector::getLocalEtag(const string &path)
 {
-    open();
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    string etag;
+
+    stmt = getStatement("SELECT localEtag FROM 'metadata' WHERE path = ? LIMIT 1;");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        etag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    }
 
+    sqlite3_reset(stmt);
+    return etag;
+}
+
+bool SqliteConnector::updateLocalEtag(const string &path, const string &localEtag)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    stmt = getStatement("UPDATE 'metadata' SET localEtag=? WHERE path=?");
+    rs = sqlite3_bind_text(stmt, 1, localEtag.c_str(), localEtag.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, path.c_str(), path.length(), NULL);
+    rs = sqlite3_step(stmt);
+
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+
+    sqlite3_reset(stmt);
+
+    return rs == SQLITE_DONE;
+}
+
+FileState SqliteConnector::getState(const string &path)
+{
     int rs;
     sqlite3_stmt *stmt = 0;
     FileState state = FileState::ICLOUD;
 
 
-    rs = sqlite3_prepare_v2(_db, "SELECT state FROM 'metadata' WHERE path = ? LIMIT 1;", -1, &stmt, 0);
+    stmt = getStatement("SELECT state FROM 'metadata' WHERE path = ? LIMIT 1;");
     rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
 
     while (sqlite3_step(stmt) == SQLITE_ROW)
@@ -164,18 +311,16 @@ FileState SqliteConnector::getState(const string &path)
         state =  static_cast<FileState>(sqlite3_column_int(stmt,0));
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+    sqlite3_reset(stmt);
     return state;
 }
 
 bool SqliteConnector::updateState(const string &path, FileState state)
 {
-    open();
     int rs;
     sqlite3_stmt *stmt = 0;
 
-    rs = sqlite3_prepare_v2(_db, "UPDATE 'metadata' SET state=? WHERE path=?", -1, &stmt, 0);
+    stmt = getStatement("UPDATE 'metadata' SET state=? WHERE path=?");
     rs = sqlite3_bind_int(stmt, 1, state);
     rs = sqlite3_bind_text(stmt, 2, path.c_str(), path.length(), NULL);
     rs = sqlite3_step(stmt);
@@ -184,135 +329,234 @@ bool SqliteConnector::updateState(const string &path, FileState state)
     {
         Log::writeErrorLog(sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
     }
-    rs = sqlite3_clear_bindings(stmt);
     rs = sqlite3_reset(stmt);
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
-
     return true;
 }
 
-std::vector<WebDAVItem> SqliteConnector::getItemsChildren(const string &parentPath)
+WebDAVItem SqliteConnector::readItem(sqlite3_stmt *stmt)
 {
-    open();
+    WebDAVItem temp;
+
+    temp.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    temp.localPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    temp.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+    temp.size = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+    temp.etag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+    temp.fileType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
+    temp.lastEditDate = Util::webDAVStringToTm(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6)));
+    temp.type =  static_cast<Itemtype>(sqlite3_column_int(stmt,7));
+    temp.state =  static_cast<FileState>(sqlite3_column_int(stmt,8));
+    temp.hide =  static_cast<HideState>(sqlite3_column_int(stmt,9));
+    temp.localEtag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 10));
+    temp.hideVersion = static_cast<unsigned int>(sqlite3_column_int64(stmt, 11));
+    return temp;
+}
 
+std::vector<WebDAVItem> SqliteConnector::getItemsChildren(const string &parentPath)
+{
     int rs;
     sqlite3_stmt *stmt = 0;
     std::vector<WebDAVItem> items;
+    std::vector<WebDAVItem> outdated;
+    const unsigned int hideVersion = ExclusionRules::current()->getVersion();
 
-    rs = sqlite3_prepare_v2(
-        _db, 
-        "SELECT title, localPath, path, size, etag, fileType, lastEditDate, type, state, hide FROM 'metadata' WHERE (path=? OR parentPath=?) AND hide <> 2 ORDER BY parentPath;", 
-        -1, &stmt, 0
-    );
+    //hidden items of older rules are loaded as they may be shown now
+    stmt = getStatement("SELECT title, localPath, path, size, etag, fileType, lastEditDate, type, state, hide, localEtag, hideVersion FROM 'metadata' WHERE (path=? OR parentPath=?) AND (hide <> 2 OR hideVersion <> ?) ORDER BY parentPath;");
     rs = sqlite3_bind_text(stmt, 1, parentPath.c_str(), parentPath.length(), NULL);
     rs = sqlite3_bind_text(stmt, 2, parentPath.c_str(), parentPath.length(), NULL);
+    rs = sqlite3_bind_int64(stmt, 3, hideVersion);
 
     const string storageLocation = NEXTCLOUD_ROOT_PATH + _fileHandler->getStorageUsername() + "/";
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        WebDAVItem temp;
+        WebDAVItem temp = readItem(stmt);
 
-        temp.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-        temp.localPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-        temp.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
-        temp.size = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
-        temp.etag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
-        temp.fileType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
-        temp.lastEditDate = Util::webDAVStringToTm(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6)));
-        temp.type =  static_cast<Itemtype>(sqlite3_column_int(stmt,7));
-        temp.state =  static_cast<FileState>(sqlite3_column_int(stmt,8));
-        temp.hide =  static_cast<HideState>(sqlite3_column_int(stmt,9));
-
-        if (iv_access(temp.localPath.c_str(), W_OK) != 0)
+        //the state of tracked files is kept up to date by the local changes
+        if (!_localStatesTracked && iv_access(temp.localPath.c_str(), W_OK) != 0)
         {
             if (temp.type == Itemtype::IFILE)
                 temp.state = FileState::ICLOUD;
         }
 
-        if (temp.hide == HideState::INOTDEFINED) {
-            temp.hide = _fileHandler->getHideState(temp.type, storageLocation, temp.path, temp.title);
+        if (temp.hide == HideState::INOTDEFINED || temp.hideVersion != hideVersion) {
+            temp.hide = getHideState(temp, storageLocation);
+            temp.hideVersion = hideVersion;
+            outdated.push_back(temp);
+            if (temp.hide == HideState::IHIDE)
+                continue;
         }
         items.push_back(temp);
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+    sqlite3_reset(stmt);
+
+    if (!outdated.empty())
+        saveHideStates(outdated);
 
     return items;
 }
 
-void SqliteConnector::deleteChild(const string &path, const string &title)
+HideState SqliteConnector::getHideState(const WebDAVItem &item, const string &storageLocation)
+{
+    string pathDecoded = item.path;
+    Util::decodeUrl(pathDecoded);
+    return _fileHandler->getHideState(item.type, storageLocation, pathDecoded, item.title);
+}
+
+void SqliteConnector::saveHideStates(const std::vector<WebDAVItem> &items)
 {
-    open();
     int rs;
     sqlite3_stmt *stmt = 0;
-    rs = sqlite3_prepare_v2(_db, "DELETE FROM 'metadata' WHERE path = ? AND title = ?", -1, &stmt, 0);
-    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
-    rs = sqlite3_bind_text(stmt, 1, title.c_str(), title.length(), NULL);
 
-    rs = sqlite3_step(stmt);
-    if (rs != SQLITE_DONE)
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    stmt = getStatement("UPDATE 'metadata' SET hide=?, hideVersion=? WHERE path=?");
+    for (const auto &item : items)
     {
-        Log::writeErrorLog(std::string("An error ocurred trying to delete the item ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        rs = sqlite3_bind_int(stmt, 1, item.hide);
+        rs = sqlite3_bind_int64(stmt, 2, item.hideVersion);
+        rs = sqlite3_bind_text(stmt, 3, item.path.c_str(), item.path.length(), NULL);
+        rs = sqlite3_step(stmt);
+        if (rs != SQLITE_DONE)
+        {
+            Log::writeErrorLog(std::string("error saving hide state ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        }
+        rs = sqlite3_reset(stmt);
     }
-    rs = sqlite3_clear_bindings(stmt);
-    rs = sqlite3_reset(stmt);
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+}
+
+int SqliteConnector::updateOutdatedHideStates(int limit)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::vector<WebDAVItem> outdated;
+    const unsigned int hideVersion = ExclusionRules::current()->getVersion();
+
+    stmt = getStatement("SELECT path, title, type FROM 'metadata' WHERE hideVersion <> ? LIMIT ?;");
+    rs = sqlite3_bind_int64(stmt, 1, hideVersion);
+    rs = sqlite3_bind_int(stmt, 2, limit);
+
+    const string storageLocation = NEXTCLOUD_ROOT_PATH + _fileHandler->getStorageUsername() + "/";
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        WebDAVItem temp;
+        temp.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        temp.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        temp.type = static_cast<Itemtype>(sqlite3_column_int(stmt, 2));
+        temp.hide = getHideState(temp, storageLocation);
+        temp.hideVersion = hideVersion;
+        outdated.push_back(temp);
+    }
+
+    sqlite3_reset(stmt);
 
+    if (!outdated.empty())
+        saveHideStates(outdated);
+
+    return outdated.size();
 }
-void SqliteConnector::deleteItemsNotBeginsWith(string beginPath) 
+
+std::unordered_map<string, StoredItem> SqliteConnector::getStoredChildren(const string &parentPath)
 {
-    open();
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::unordered_map<string, StoredItem> items;
 
-    // escape characters
-    beginPath = std::regex_replace(beginPath, std::regex("%"), "#%");
-    beginPath = std::regex_replace(beginPath, std::regex("_"), "#_");
-    beginPath = beginPath + "%";
+    stmt = getStatement("SELECT path, state, etag, localEtag FROM 'metadata' WHERE path=? OR parentPath=?;");
+    rs = sqlite3_bind_text(stmt, 1, parentPath.c_str(), parentPath.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, parentPath.c_str(), parentPath.length(), NULL);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        StoredItem temp;
+        temp.state = static_cast<FileState>(sqlite3_column_int(stmt, 1));
+        temp.etag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+        temp.localEtag = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+        items.emplace(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)), std::move(temp));
+    }
+
+    sqlite3_reset(stmt);
 
+    return items;
+}
+
+bool SqliteConnector::isSubtreeDownloaded(const string &path)
+{
     int rs;
     sqlite3_stmt *stmt = 0;
-    rs = sqlite3_prepare_v2(_db, "DELETE FROM 'metadata' WHERE path NOT LIKE ? ESCAPE '#'", -1, &stmt, 0);
-    rs = sqlite3_bind_text(stmt, 1, beginPath.c_str(), beginPath.length(), NULL);
+    bool downloaded = true;
+
+    //the walk only descends into downloaded folders as any other folder already decides the result
+    stmt = getStatement(
+        "WITH RECURSIVE subtree(path, type, state) AS ("
+        " SELECT path, type, state FROM 'metadata' WHERE parentPath = ?1 AND path <> ?1 AND hide <> 2"
+        " UNION ALL"
+        " SELECT m.path, m.type, m.state FROM 'metadata' m JOIN subtree s ON m.parentPath = s.path"
+        " WHERE s.type = ?2 AND s.state = ?3 AND m.path <> m.parentPath AND m.hide <> 2"
+        ") SELECT EXISTS (SELECT 1 FROM subtree WHERE (type = ?2 AND state <> ?3) OR (type <> ?2 AND state = ?4));");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_bind_int(stmt, 2, Itemtype::IFOLDER);
+    rs = sqlite3_bind_int(stmt, 3, FileState::IDOWNLOADED);
+    rs = sqlite3_bind_int(stmt, 4, FileState::ICLOUD);
 
     rs = sqlite3_step(stmt);
-    if (rs != SQLITE_DONE)
+    if (rs == SQLITE_ROW)
     {
-        Log::writeErrorLog(std::string("An error ocurred trying to delete the items that begins with " + beginPath) + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        downloaded = sqlite3_column_int(stmt, 0) == 0;
     }
-    rs = sqlite3_clear_bindings(stmt);
-    rs = sqlite3_reset(stmt);
+    else
+    {
+        Log::writeErrorLog(std::string("error checking download state of ") + path + " " + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+
+    sqlite3_reset(stmt);
+
+    return downloaded;
 }
 
-bool SqliteConnector::resetHideState()
+void SqliteConnector::deleteChild(const string &path, const string &title)
 {
-    open();
     int rs;
     sqlite3_stmt *stmt = 0;
+    stmt = getStatement("DELETE FROM 'metadata' WHERE path = ? AND title = ?");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, title.c_str(), title.length(), NULL);
 
-    rs = sqlite3_prepare_v2(_db, "UPDATE 'metadata' SET hide=0", -1, &stmt, 0);
     rs = sqlite3_step(stmt);
-
     if (rs != SQLITE_DONE)
     {
-        Log::writeErrorLog(sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        Log::writeErrorLog(std::string("An error ocurred trying to delete the item ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
     }
-    rs = sqlite3_clear_bindings(stmt);
     rs = sqlite3_reset(stmt);
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+}
+void SqliteConnector::deleteItemsNotBeginsWith(string beginPath) 
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    string endPath = getPrefixEnd(beginPath);
 
-    return true;
+    // a range instead of LIKE so the primary key index can be used
+    stmt = getStatement("DELETE FROM 'metadata' WHERE path < ? OR path >= ?");
+    rs = sqlite3_bind_text(stmt, 1, beginPath.c_str(), beginPath.length(), NULL);
+    if (!endPath.empty())
+        rs = sqlite3_bind_text(stmt, 2, endPath.c_str(), endPath.length(), NULL);
+
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("An error ocurred trying to delete the items that begins with " + beginPath) + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    rs = sqlite3_reset(stmt);
 }
 
 void SqliteConnector::deleteChildren(const string &parentPath)
 {
     //TODO missing the onces where parentPath is one folder deeper and also destroyed
-    open();
     int rs;
     sqlite3_stmt *stmt = 0;
-    rs = sqlite3_prepare_v2(_db, "DELETE FROM 'metadata' WHERE parentPath like ?", -1, &stmt, 0);
+    stmt = getStatement("DELETE FROM 'metadata' WHERE parentPath = ?");
     rs = sqlite3_bind_text(stmt, 1, parentPath.c_str(), parentPath.length(), NULL);
 
     rs = sqlite3_step(stmt);
@@ -320,27 +564,135 @@ void SqliteConnector::deleteChildren(const string &parentPath)
     {
         Log::writeErrorLog(std::string("An error ocurred trying to delete items of the path ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
     }
-    rs = sqlite3_clear_bindings(stmt);
     rs = sqlite3_reset(stmt);
 
 }
 
 bool SqliteConnector::saveItemsChildren(const std::vector<WebDAVItem> &items)
 {
-    open();
     int rs;
     sqlite3_stmt *stmt = 0;
-    string parent = items.at(0).path;
+    const string &parent = items.at(0).path;
+    auto start = std::chrono::steady_clock::now();
+
+    //Sqlite version to old for upserts... is 3.18, require 3.24
+    //therefore the stored rows are compared and only the changed ones are written
+    std::unordered_map<string, string> stored;
+    stmt = getStatement("SELECT path, title, localPath, size, etag, fileType, lastEditDate, type, state, hide, localEtag, hideVersion FROM 'metadata' WHERE path=? OR parentPath=?;");
+    rs = sqlite3_bind_text(stmt, 1, parent.c_str(), parent.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, parent.c_str(), parent.length(), NULL);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        string row;
+        for (int i = 1; i < 12; i++)
+        {
+            const char *value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
+            row.append(value ? value : "");
+            row.push_back('\0');
+        }
+        stored.emplace(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)), row);
+    }
+    sqlite3_reset(stmt);
+
+    int inserted = 0;
+    int updated = 0;
+    int deleted = 0;
 
-    //Sqlite version to old... is 3.18, require 3.24
-    //Log::writeInfoLog(sqlite3_libversion());
-    //rs = sqlite3_prepare_v2(_db, "INSERT INTO 'metadata' (title, localPath, path, size, parentPath, etag, fileType, lastEditDate, type, state, key) VALUES (?,?,?,?,?,?,?,?,?,?,?) ON CONFLICT(key) DO UPDATE SET etag=?, size=?, lastEditDate=? WHERE metadata.etag <> ?;", -1, &stmt, 0);
-    deleteChildren(parent);
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
 
-    for (auto item : items)
+    sqlite3_stmt *insertStmt = getStatement("INSERT INTO 'metadata' (title, localPath, size, etag, fileType, lastEditDate, type, state, hide, localEtag, hideVersion, parentPath, path) VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?);");
+    sqlite3_stmt *updateStmt = getStatement("UPDATE 'metadata' SET title=?, localPath=?, size=?, etag=?, fileType=?, lastEditDate=?, type=?, state=?, hide=?, localEtag=?, hideVersion=? WHERE path=?;");
+    for (const auto &item : items)
     {
-        rs = sqlite3_prepare_v2(_db, "INSERT INTO 'metadata' (title, localPath, path, size, parentPath, etag, fileType, lastEditDate, type, state, hide) VALUES (?,?,?,?,?,?,?,?,?,?,?);", -1, &stmt, 0);
-        rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+        string lastEditDateString = Util::webDAVTmToString(item.lastEditDate);
+        string type = std::to_string(item.type);
+        string state = std::to_string(item.state);
+        string hide = std::to_string(item.hide);
+        string hideVersion = std::to_string(item.hideVersion);
+        const string *values[] = {&item.title, &item.localPath, &item.size, &item.etag, &item.fileType, &lastEditDateString, &type, &state, &hide, &item.localEtag, &hideVersion};
+
+        auto storedRow = stored.find(item.path);
+        if (storedRow != stored.end())
+        {
+            string row;
+            for (const string *value : values)
+            {
+                row.append(*value);
+                row.push_back('\0');
+            }
+            bool changed = row != storedRow->second;
+            stored.erase(storedRow);
+            if (!changed)
+                continue;
+            stmt = updateStmt;
+            updated++;
+        }
+        else
+        {
+            stmt = insertStmt;
+            inserted++;
+        }
+
+        rs = sqlite3_bind_text(stmt, 1, item.title.c_str(), item.title.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 2, item.localPath.c_str(), item.localPath.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 3, item.size.c_str(), item.size.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 4, item.etag.c_str(), item.etag.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 5, item.fileType.c_str(), item.fileType.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 6, lastEditDateString.c_str(), lastEditDateString.length(), NULL);
+        rs = sqlite3_bind_int(stmt, 7, item.type);
+        rs = sqlite3_bind_int(stmt, 8, item.state);
+        rs = sqlite3_bind_int(stmt, 9, item.hide);
+        rs = sqlite3_bind_text(stmt, 10, item.localEtag.c_str(), item.localEtag.length(), NULL);
+        rs = sqlite3_bind_int64(stmt, 11, item.hideVersion);
+        if (stmt == insertStmt)
+        {
+            //the folder itself belongs to the folder above
+            string itemParent = (&item == &items.front()) ? item.path.substr(0, item.path.find_last_of('/', item.path.length() - 2) + 1) : parent;
+            rs = sqlite3_bind_text(stmt, 12, itemParent.c_str(), itemParent.length(), SQLITE_TRANSIENT);
+            rs = sqlite3_bind_text(stmt, 13, item.path.c_str(), item.path.length(), NULL);
+        }
+        else
+        {
+            rs = sqlite3_bind_text(stmt, 12, item.path.c_str(), item.path.length(), NULL);
+        }
+
+        rs = sqlite3_step(stmt);
+        if (rs != SQLITE_DONE)
+        {
+            Log::writeErrorLog(std::string("error saving item ") + item.path + " " + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        }
+        rs = sqlite3_reset(stmt);
+    }
+
+    // the remaining rows do not exist anymore on the server, folders are removed with their content
+    for (const auto &removed : stored)
+    {
+        deleteItem(removed.first);
+        deleted++;
+    }
+
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    Log::writeInfoLog("Saved " + std::to_string(items.size()) + " items of " + parent + " (" + std::to_string(inserted) + " inserted, " + std::to_string(updated) + " updated, " + std::to_string(deleted) + " deleted) in " + std::to_string(duration / 1000) + " ms, " + std::to_string(duration > 0 ? items.size() * 1000000 / duration : items.size()) + " rows/s");
+
+    return true;
+}
+
+bool SqliteConnector::saveItems(const std::vector<WebDAVItem> &items)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    stmt = getStatement("INSERT OR REPLACE INTO 'metadata' (title, localPath, path, size, parentPath, etag, fileType, lastEditDate, type, state, hide, localEtag, hideVersion) VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?);");
+
+    for (const auto &item : items)
+    {
+        //the parent is the path without the last segment (folders end with a slash)
+        string parent = item.path.substr(0, item.path.find_last_of('/', item.path.length() - 2) + 1);
+        string lastEditDateString = Util::webDAVTmToString(item.lastEditDate);
+
         rs = sqlite3_bind_text(stmt, 1, item.title.c_str(), item.title.length(), NULL);
         rs = sqlite3_bind_text(stmt, 2, item.localPath.c_str(), item.localPath.length(), NULL);
         rs = sqlite3_bind_text(stmt, 3, item.path.c_str(), item.path.length(), NULL);
@@ -348,46 +700,412 @@ bool SqliteConnector::saveItemsChildren(const std::vector<WebDAVItem> &items)
         rs = sqlite3_bind_text(stmt, 5, parent.c_str(), parent.length(), NULL);
         rs = sqlite3_bind_text(stmt, 6, item.etag.c_str(), item.etag.length(), NULL);
         rs = sqlite3_bind_text(stmt, 7, item.fileType.c_str(), item.fileType.length(), NULL);
-        string lastEditDateString = Util::webDAVTmToString(item.lastEditDate);
         rs = sqlite3_bind_text(stmt, 8, lastEditDateString.c_str(), lastEditDateString.length(), NULL);
         rs = sqlite3_bind_int(stmt, 9, item.type);
         rs = sqlite3_bind_int(stmt, 10, item.state);
         rs = sqlite3_bind_int(stmt, 11, item.hide);
+        rs = sqlite3_bind_text(stmt, 12, item.localEtag.c_str(), item.localEtag.length(), NULL);
+        rs = sqlite3_bind_int64(stmt, 13, item.hideVersion);
 
         rs = sqlite3_step(stmt);
-        if (rs == SQLITE_CONSTRAINT)
+        if (rs != SQLITE_DONE)
         {
-            rs = sqlite3_clear_bindings(stmt);
-            rs = sqlite3_reset(stmt);
-
-            rs = sqlite3_prepare_v2(_db, "UPDATE 'metadata' SET state=?, etag=?, lastEditDate=?, size=? WHERE path=?", -1, &stmt, 0);
-            rs = sqlite3_bind_int(stmt, 1, item.state);
-            rs = sqlite3_bind_text(stmt, 2, item.etag.c_str(), item.etag.length(), NULL);
-            string lastEditDateString = Util::webDAVTmToString(item.lastEditDate);
-            rs = sqlite3_bind_text(stmt, 3, lastEditDateString.c_str(), lastEditDateString.length(), NULL);
-            rs = sqlite3_bind_text(stmt, 4, item.size.c_str(), item.size.length(), NULL);
-            rs = sqlite3_bind_text(stmt, 5, item.path.c_str(), item.path.length(), NULL);
-            rs = sqlite3_step(stmt);
-
-            if (rs != SQLITE_DONE)
-            {
-                Log::writeErrorLog(sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
-            }
-            rs = sqlite3_clear_bindings(stmt);
-            rs = sqlite3_reset(stmt);
+            Log::writeErrorLog(std::string("error inserting into table ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
         }
-        else if (rs != SQLITE_DONE)
+        rs = sqlite3_reset(stmt);
+    }
+
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+
+    return true;
+}
+
+std::vector<std::string> SqliteConnector::getPathsBelow(const string &path)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::vector<string> paths;
+    string endPath = getPrefixEnd(path);
+
+    stmt = getStatement("SELECT path FROM 'metadata' WHERE path > ? AND path < ?");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, endPath.c_str(), endPath.length(), NULL);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        paths.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+
+    sqlite3_reset(stmt);
+    return paths;
+}
+
+void SqliteConnector::deleteItem(const string &path)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    if (!path.empty() && path.back() == '/')
+    {
+        // the folder and its content are the range of paths beginning with it
+        string endPath = getPrefixEnd(path);
+        stmt = getStatement("DELETE FROM 'metadata' WHERE path >= ? AND path < ?");
+        rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 2, endPath.c_str(), endPath.length(), NULL);
+    }
+    else
+    {
+        stmt = getStatement("DELETE FROM 'metadata' WHERE path = ?");
+        rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    }
+
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("An error ocurred trying to delete the item " + path) + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+
+    sqlite3_reset(stmt);
+}
+
+string SqliteConnector::getSyncToken(const string &path)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    string token;
+
+    stmt = getStatement("SELECT token FROM 'syncToken' WHERE path = ? LIMIT 1;");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        token = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    }
+
+    sqlite3_reset(stmt);
+    return token;
+}
+
+bool SqliteConnector::setSyncToken(const string &path, const string &token)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    stmt = getStatement("INSERT OR REPLACE INTO 'syncToken' (path, token) VALUES (?,?)");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_bind_text(stmt, 2, token.c_str(), token.length(), NULL);
+
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("error saving sync-token ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+
+    sqlite3_reset(stmt);
+    return rs == SQLITE_DONE;
+}
+
+bool SqliteConnector::addLocalChanges(const std::vector<LocalChange> &changes)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    bool success = true;
+
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    stmt = getStatement("INSERT OR REPLACE INTO 'localJournal' (localPath, present) VALUES (?,?)");
+    for (const auto &change : changes)
+    {
+        rs = sqlite3_bind_text(stmt, 1, change.localPath.c_str(), change.localPath.length(), NULL);
+        rs = sqlite3_bind_int(stmt, 2, change.exists ? 1 : 0);
+        rs = sqlite3_step(stmt);
+        if (rs != SQLITE_DONE)
         {
-            Log::writeErrorLog(std::string("error inserting into table ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+            Log::writeErrorLog(std::string("error saving local change ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+            success = false;
         }
-        rs = sqlite3_clear_bindings(stmt);
         rs = sqlite3_reset(stmt);
     }
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+
+    return success;
+}
+
+int SqliteConnector::applyLocalChanges()
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::vector<WebDAVItem> changed;
+    std::vector<string> removedFolders;
+
+    //only the items whose local path is part of the journal are checked
+    stmt = getStatement("SELECT m.path, m.localPath, m.type, m.state, j.present FROM 'localJournal' j JOIN 'metadata' m ON m.localPath = j.localPath;");
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        WebDAVItem temp;
+        temp.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        temp.localPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        temp.type = static_cast<Itemtype>(sqlite3_column_int(stmt, 2));
+        temp.state = static_cast<FileState>(sqlite3_column_int(stmt, 3));
+        bool exists = sqlite3_column_int(stmt, 4) != 0;
+
+        //the removal of a folder is not reported for its content
+        if (!exists && temp.type == Itemtype::IFOLDER)
+            removedFolders.push_back(temp.localPath);
+
+        FileState state = getLocalState(temp.type, temp.state, exists);
+        if (state != temp.state)
+        {
+            temp.state = state;
+            changed.push_back(temp);
+        }
+    }
+    sqlite3_reset(stmt);
 
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    stmt = getStatement("UPDATE 'metadata' SET state = CASE WHEN type = ?1 THEN ?2 WHEN state = ?3 THEN ?4 ELSE state END WHERE localPath >= ?5 AND localPath < ?6;");
+    for (const auto &folder : removedFolders)
+    {
+        string beginPath = folder + "/";
+        string endPath = getPrefixEnd(beginPath);
+        rs = sqlite3_bind_int(stmt, 1, Itemtype::IFILE);
+        rs = sqlite3_bind_int(stmt, 2, FileState::ICLOUD);
+        rs = sqlite3_bind_int(stmt, 3, FileState::IDOWNLOADED);
+        rs = sqlite3_bind_int(stmt, 4, FileState::ISYNCED);
+        rs = sqlite3_bind_text(stmt, 5, beginPath.c_str(), beginPath.length(), NULL);
+        rs = sqlite3_bind_text(stmt, 6, endPath.c_str(), endPath.length(), NULL);
+        rs = sqlite3_step(stmt);
+        if (rs != SQLITE_DONE)
+        {
+            Log::writeErrorLog(std::string("error updating removed folder ") + folder + " " + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        }
+        rs = sqlite3_reset(stmt);
+    }
+    saveLocalStates(changed);
+    rs = sqlite3_exec(_db, "DELETE FROM 'localJournal';", NULL, NULL, NULL);
     sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(_db);
+    if (!changed.empty() || !removedFolders.empty())
+        Log::writeInfoLog("Applied local changes to " + std::to_string(changed.size()) + " items and " + std::to_string(removedFolders.size()) + " removed folders");
 
-    return true;
+    return changed.size();
+}
+
+int SqliteConnector::reconcileLocalFiles(const std::unordered_set<string> &existing)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::vector<WebDAVItem> changed;
+
+    stmt = getStatement("SELECT path, localPath, type, state FROM 'metadata';");
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        WebDAVItem temp;
+        temp.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        temp.localPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        temp.type = static_cast<Itemtype>(sqlite3_column_int(stmt, 2));
+        temp.state = static_cast<FileState>(sqlite3_column_int(stmt, 3));
+
+        FileState state = getLocalState(temp.type, temp.state, existing.find(temp.localPath) != existing.end());
+        if (state != temp.state)
+        {
+            temp.state = state;
+            changed.push_back(temp);
+        }
+    }
+    sqlite3_reset(stmt);
+
+    //the journal only contains changes that are part of the scan
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    saveLocalStates(changed);
+    rs = sqlite3_exec(_db, "DELETE FROM 'localJournal';", NULL, NULL, NULL);
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+
+    return changed.size();
+}
+
+FileState SqliteConnector::getLocalState(Itemtype type, FileState state, bool exists)
+{
+    if (type == Itemtype::IFILE)
+    {
+        //like in the comparison with the server a file with the stored etag is synced
+        if (!exists)
+            return FileState::ICLOUD;
+        return (state == FileState::ICLOUD) ? FileState::ISYNCED : state;
+    }
+
+    //the structure of a removed folder is still known
+    if (!exists && state == FileState::IDOWNLOADED)
+        return FileState::ISYNCED;
+    return state;
+}
+
+void SqliteConnector::saveLocalStates(const std::vector<WebDAVItem> &items)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::set<string> notDownloaded;
+
+    stmt = getStatement("UPDATE 'metadata' SET state=? WHERE path=?");
+    for (const auto &item : items)
+    {
+        rs = sqlite3_bind_int(stmt, 1, item.state);
+        rs = sqlite3_bind_text(stmt, 2, item.path.c_str(), item.path.length(), NULL);
+        rs = sqlite3_step(stmt);
+        if (rs != SQLITE_DONE)
+        {
+            Log::writeErrorLog(std::string("error saving local state ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+        }
+        rs = sqlite3_reset(stmt);
+
+        if (item.state == FileState::ICLOUD || item.type == Itemtype::IFOLDER)
+        {
+            string parent = item.path;
+            while (parent.length() > NEXTCLOUD_ROOT_PATH.length())
+            {
+                parent = parent.substr(0, parent.find_last_of('/', parent.length() - 2) + 1);
+                if (!notDownloaded.insert(parent).second)
+                    break;
+            }
+        }
+    }
+
+    //folders that contain items which are no longer local are not downloaded anymore
+    stmt = getStatement("UPDATE 'metadata' SET state=? WHERE path=? AND state=?");
+    for (const auto &path : notDownloaded)
+    {
+        rs = sqlite3_bind_int(stmt, 1, FileState::ISYNCED);
+        rs = sqlite3_bind_text(stmt, 2, path.c_str(), path.length(), NULL);
+        rs = sqlite3_bind_int(stmt, 3, FileState::IDOWNLOADED);
+        rs = sqlite3_step(stmt);
+        rs = sqlite3_reset(stmt);
+    }
+}
+
+bool SqliteConnector::addTransfers(const std::vector<WebDAVItem> &items, TransferPriority priority, const string &folder)
+{
+    int rs;
+    sqlite3_stmt *insert = 0;
+    sqlite3_stmt *update = 0;
+    bool success = true;
+
+    rs = sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+    // the rowid keeps the order in which the files have been queued
+    insert = getStatement("INSERT OR IGNORE INTO 'transferQueue' (path, priority, folder) VALUES (?,?,?)");
+    update = getStatement("UPDATE 'transferQueue' SET priority=? WHERE path=? AND priority<?");
+    for (const auto &item : items)
+    {
+        rs = sqlite3_bind_text(insert, 1, item.path.c_str(), item.path.length(), NULL);
+        rs = sqlite3_bind_int(insert, 2, static_cast<int>(priority));
+        rs = sqlite3_bind_text(insert, 3, folder.c_str(), folder.length(), NULL);
+        rs = sqlite3_step(insert);
+        if (rs != SQLITE_DONE)
+        {
+            Log::writeErrorLog(std::string("error queueing transfer ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+            success = false;
+        }
+        rs = sqlite3_reset(insert);
+
+        rs = sqlite3_bind_int(update, 1, static_cast<int>(priority));
+        rs = sqlite3_bind_text(update, 2, item.path.c_str(), item.path.length(), NULL);
+        rs = sqlite3_bind_int(update, 3, static_cast<int>(priority));
+        rs = sqlite3_step(update);
+        rs = sqlite3_reset(update);
+    }
+    sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
+
+    return success;
+}
+
+void SqliteConnector::cleanTransfers()
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    stmt = getStatement("DELETE FROM 'transferQueue' WHERE attempts>=? OR path NOT IN (SELECT path FROM 'metadata')");
+    rs = sqlite3_bind_int(stmt, 1, TRANSFER_MAX_ATTEMPTS);
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("error cleaning transfers ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    sqlite3_reset(stmt);
+}
+
+std::vector<WebDAVItem> SqliteConnector::getTransfers(int limit)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+    std::vector<WebDAVItem> items;
+
+    stmt = getStatement("SELECT m.title, m.localPath, m.path, m.size, m.etag, m.fileType, m.lastEditDate, m.type, m.state, m.hide, m.localEtag, m.hideVersion FROM 'transferQueue' q JOIN 'metadata' m ON m.path = q.path ORDER BY q.priority DESC, q.rowid LIMIT ?;");
+    rs = sqlite3_bind_int(stmt, 1, limit);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        items.push_back(readItem(stmt));
+
+    sqlite3_reset(stmt);
+    return items;
+}
+
+std::vector<std::string> SqliteConnector::getTransferFolders()
+{
+    sqlite3_stmt *stmt = 0;
+    std::vector<string> folders;
+
+    stmt = getStatement("SELECT DISTINCT folder FROM 'transferQueue' WHERE folder <> '';");
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        folders.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+
+    sqlite3_reset(stmt);
+    return folders;
+}
+
+int SqliteConnector::countTransfers()
+{
+    sqlite3_stmt *stmt = 0;
+    int count = 0;
+
+    stmt = getStatement("SELECT COUNT(*) FROM 'transferQueue';");
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        count = sqlite3_column_int(stmt, 0);
+
+    sqlite3_reset(stmt);
+    return count;
+}
+
+void SqliteConnector::removeTransfer(const string &path)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    stmt = getStatement("DELETE FROM 'transferQueue' WHERE path=?");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("error removing transfer ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    sqlite3_reset(stmt);
+}
+
+void SqliteConnector::addTransferAttempt(const string &path)
+{
+    int rs;
+    sqlite3_stmt *stmt = 0;
+
+    stmt = getStatement("UPDATE 'transferQueue' SET attempts=attempts+1 WHERE path=?");
+    rs = sqlite3_bind_text(stmt, 1, path.c_str(), path.length(), NULL);
+    rs = sqlite3_step(stmt);
+    if (rs != SQLITE_DONE)
+    {
+        Log::writeErrorLog(std::string("error updating transfer ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
+    sqlite3_reset(stmt);
+}
+
+void SqliteConnector::clearTransfers()
+{
+    int rs;
+
+    rs = sqlite3_exec(_db, "DELETE FROM 'transferQueue';", NULL, 0, NULL);
+    if (rs != SQLITE_OK)
+    {
+        Log::writeErrorLog(std::string("error clearing transfers ") + sqlite3_errmsg(_db) + std::string(" (Error Code: ") + std::to_string(rs) + ")");
+    }
 }
@@ -13,12 +13,37 @@
 #include "webDAVModel.h"
 #include "sqlite3.h"
 #include "fileHandler.h"
+#include "localWatcher.h"
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <memory>
 
+//failed downloads of a queued file until it is dropped from the queue
+const int TRANSFER_MAX_ATTEMPTS = 3;
+
+/**
+ * Order of the queued downloads, higher values are downloaded first
+ */
+enum class TransferPriority
+{
+    IFOLDER = 0,
+    ITAPPED = 1
+};
+
+/**
+ * Values of an item that are stored to compare it with the server
+ */
+struct StoredItem
+{
+    FileState state;
+    std::string etag;
+    std::string localEtag;
+};
+
 class SqliteConnector
 {
 public:
@@ -29,6 +54,12 @@ public:
 
     ~SqliteConnector();
 
+    SqliteConnector(const SqliteConnector &) = delete;
+    SqliteConnector &operator=(const SqliteConnector &) = delete;
+
+    /**
+     * Opens the connection and creates the tables, is only done once at construction
+     */
     bool open();
 
     int getDbVersion();
@@ -37,27 +68,193 @@ public:
 
     std::string getEtag(const std::string &path);
 
+    /**
+     * Returns the etag of the version that has been downloaded or an empty string
+     */
+    std::string getLocalEtag(const std::string &path);
+
+    bool updateLocalEtag(const std::string &path, const std::string &localEtag);
+
     FileState getState(const std::string &path);
 
     bool updateState(const std::string &path, FileState state);
 
     std::vector<WebDAVItem> getItemsChildren(const std::string &parenthPath);
 
+    /**
+     * Returns state and etags of a folder and its children with one query
+     *
+     * @param parentPath path of the folder
+     * @return stored values keyed by the path of the item
+     */
+    std::unordered_map<std::string, StoredItem> getStoredChildren(const std::string &parentPath);
+
+    /**
+     * Checks with one recursive query if all files below the folder are downloaded
+     * and all subfolders are marked as downloaded, hidden items are ignored
+     *
+     * @param path path of the folder
+     */
+    bool isSubtreeDownloaded(const std::string &path);
+
     void deleteChildren(const std::string &parentPath);
 
     void deleteChild(const std::string &path, const std::string &title);
 
     void deleteItemsNotBeginsWith(std::string beginPath);
 
-    bool resetHideState();
+    /**
+     * Evaluates the hide state of items whose state belongs to older exclusion rules
+     *
+     * @param limit maximum number of items that are evaluated
+     * @return number of evaluated items, if it is lower than limit all items are up to date
+     */
+    int updateOutdatedHideStates(int limit);
 
     bool saveItemsChildren(const std::vector<WebDAVItem> &children);
 
+    /**
+     * Inserts or updates single items that can belong to different folders
+     *
+     * @param items items that shall be saved, the parent is taken from their path
+     */
+    bool saveItems(const std::vector<WebDAVItem> &items);
+
+    /**
+     * Deletes an item and if it is a folder everything below it
+     *
+     * @param path path of the item
+     */
+    void deleteItem(const std::string &path);
+
+    /**
+     * Returns the paths of all stored items below the folder, the folder itself is not part of it
+     *
+     * @param path path of the folder
+     */
+    std::vector<std::string> getPathsBelow(const std::string &path);
+
+    /**
+     * Returns the sync-token stored for the collection or an empty string if there is none
+     */
+    std::string getSyncToken(const std::string &path);
+
+    bool setSyncToken(const std::string &path, const std::string &token);
+
+    /**
+     * Records local changes in the journal, they are applied with applyLocalChanges
+     */
+    bool addLocalChanges(const std::vector<LocalChange> &changes);
+
+    /**
+     * Updates the state of the items whose local path is part of the journal and clears the journal
+     *
+     * @return number of items whose state has changed
+     */
+    int applyLocalChanges();
+
+    /**
+     * Compares the state of all items with the files found by a complete scan and clears the journal
+     *
+     * @param existing local paths of all files and folders below the storage location
+     * @return number of items whose state has changed
+     */
+    int reconcileLocalFiles(const std::unordered_set<std::string> &existing);
+
+    /**
+     * If set the stored state of files is trusted and the local files are not checked while reading
+     */
+    void setLocalStatesTracked(bool tracked) { _localStatesTracked = tracked; };
+
+    /**
+     * Adds files to the download queue, it is kept until they are downloaded or the queue is cleared
+     * Files that are already queued keep their position and get the higher priority
+     *
+     * @param items files that shall be downloaded
+     * @param priority priority of the files
+     * @param folder folder that is marked as downloaded once its files are done, can be empty
+     */
+    bool addTransfers(const std::vector<WebDAVItem> &items, TransferPriority priority, const std::string &folder);
+
+    /**
+     * Returns the next files of the download queue ordered by priority and the time they have been queued
+     *
+     * @param limit maximum number of files
+     */
+    std::vector<WebDAVItem> getTransfers(int limit);
+
+    /**
+     * Removes files from the download queue that failed too often or are no longer stored
+     */
+    void cleanTransfers();
+
+    /**
+     * Returns the folders whose files are part of the download queue
+     */
+    std::vector<std::string> getTransferFolders();
+
+    int countTransfers();
+
+    void removeTransfer(const std::string &path);
+
+    /**
+     * Counts a failed download, the file is dropped from the queue after TRANSFER_MAX_ATTEMPTS
+     */
+    void addTransferAttempt(const std::string &path);
+
+    void clearTransfers();
+
 private:
+    /**
+     * Returns the state of an item after its local file has been created or removed
+     */
+    static FileState getLocalState(Itemtype type, FileState state, bool exists);
+
+    /**
+     * Saves the states and marks the parents of items that are no longer local as not downloaded
+     */
+    void saveLocalStates(const std::vector<WebDAVItem> &items);
+
+    /**
+     * Evaluates the hide state of the item with the current exclusion rules
+     */
+    HideState getHideState(const WebDAVItem &item, const std::string &storageLocation);
+
+    /**
+     * Saves hide state and rule version of the items in one transaction
+     */
+    void saveHideStates(const std::vector<WebDAVItem> &items);
+
+    /**
+     * Creates the indexes of the metadata table
+     */
+    void createIndexes();
+
+    /**
+     * Reads an item from the columns title, localPath, path, size, etag, fileType, lastEditDate, type, state, hide, localEtag, hideVersion
+     */
+    static WebDAVItem readItem(sqlite3_stmt *stmt);
+
+    /**
+     * Returns the smallest string that is greater than every string beginning with prefix
+     * so that prefix searches can use a range on an index
+     */
+    static std::string getPrefixEnd(std::string prefix);
+
+    /**
+     * Returns the prepared statement for the query, it is only prepared at the first call and reset afterwards
+     *
+     * @param sql query of the statement
+     * @return statement or nullptr if it could not be prepared
+     */
+    sqlite3_stmt *getStatement(const std::string &sql);
+
     std::string _dbpath;
-    sqlite3 *_db;
+    sqlite3 *_db = nullptr;
+    std::unordered_map<std::string, sqlite3_stmt *> _statements;
 
     std::shared_ptr<FileHandler> _fileHandler;
+    bool _localStatesTracked = false;
 };
 
 #endif
@@ -20,6 +20,12 @@
 #include <sstream>
 #include <math.h>
 #include <regex>
+#include <cstdio>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
 
 using std::ifstream;
 using std::ofstream;
@@ -61,13 +67,230 @@ WebDAV::WebDAV()
         _url = Util::getConfig<string>("url");
         _ignoreCert = Util::getConfig<int>("ignoreCert", -1);
     }
+    _retry = RetryPolicy(_url);
+
+    //share DNS, TLS sessions and open connections between all requests of the app
+    _curlShare = curl_share_init();
+    if (_curlShare)
+    {
+        curl_share_setopt(_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+        curl_share_setopt(_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
 }
 
 WebDAV::~WebDAV() 
 {
+    Log::writeInfoLog("Connections opened: " + std::to_string(_openedConnections) + ", reused: " + std::to_string(_reusedConnections));
+    if (_curl)
+        curl_easy_cleanup(_curl);
+    for (CURL *handle : _transferHandles)
+        curl_easy_cleanup(handle);
+    if (_curlMulti)
+        curl_multi_cleanup(_curlMulti);
+    if (_curlShare)
+        curl_share_cleanup(_curlShare);
     _fileHandler.reset();
 }
 
+CURL *WebDAV::prepareCurl(const string &url)
+{
+    if (!_curl)
+    {
+        _curl = curl_easy_init();
+        if (!_curl)
+            return nullptr;
+    }
+    else
+    {
+        curl_easy_reset(_curl);
+    }
+
+    setCommonOptions(_curl, url);
+    curl_easy_setopt(_curl, CURLOPT_HEADERFUNCTION, WebDAV::readHeader);
+    curl_easy_setopt(_curl, CURLOPT_HEADERDATA, &_responseHeaders);
+    if (_cancel || _onProgress)
+    {
+        curl_easy_setopt(_curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(_curl, CURLOPT_XFERINFOFUNCTION, WebDAV::requestProgress);
+        curl_easy_setopt(_curl, CURLOPT_XFERINFODATA, this);
+    }
+    return _curl;
+}
+
+void WebDAV::setHandlers(std::function<void(int, const string &, const string &, int)> onMessage, std::function<void(const string &, int)> onProgress)
+{
+    _onMessage = onMessage;
+    _onProgress = onProgress;
+}
+
+void WebDAV::showMessage(int icon, const string &title, const string &text, int timeout)
+{
+    if (_onMessage)
+        _onMessage(icon, title, text, timeout);
+    else
+        Message(icon, title.c_str(), text.c_str(), timeout);
+}
+
+void WebDAV::showProgress(const string &text, int percent)
+{
+    _progressText = text;
+    _lastPercentage = percent;
+    if (_onProgress)
+        _onProgress(text, percent);
+    else
+        UpdateProgressbar(text.c_str(), percent);
+}
+
+void WebDAV::reportError(RequestError error, const string &request, const string &text)
+{
+    Log::writeErrorLog(request + ": " + text);
+    if (error == RequestError::ICANCELLED)
+        return;
+    if (_onMessage)
+        _report.add(error, request);
+    else
+        showMessage(ICON_ERROR, "Error", text, 4000);
+}
+
+ErrorReport WebDAV::takeReport()
+{
+    ErrorReport report = _report;
+    _report.clear();
+    return report;
+}
+
+size_t WebDAV::readHeader(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    ResponseHeaders *headers = static_cast<ResponseHeaders *>(userdata);
+    string header(buffer, size * nitems);
+    long retryAfter = RetryPolicy::parseRetryAfter(header);
+    if (retryAfter >= 0)
+    {
+        headers->retryAfter = retryAfter;
+        return size * nitems;
+    }
+
+    size_t colon = header.find(':');
+    if (colon == string::npos)
+        return size * nitems;
+    string name = header.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "oc-etag" || (name == "etag" && headers->etag.empty()))
+    {
+        string value = header.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+        headers->etag = value;
+    }
+    return size * nitems;
+}
+
+RequestError WebDAV::performRequest(CURL *curl, const string &request, PropfindParser *parser, CURLcode &res, long &responseCode)
+{
+    for (int attempt = 1;; attempt++)
+    {
+        responseCode = 0;
+        if (!_retry.allowRequest())
+        {
+            res = CURLE_COULDNT_CONNECT;
+            Log::writeErrorLog(request + " not sent as the server did not respond to the last requests");
+            return RequestError::IUNAVAILABLE;
+        }
+
+        _responseHeaders = ResponseHeaders();
+        res = curl_easy_perform(curl);
+        trackConnections(curl);
+        if (res == CURLE_OK)
+        {
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+            if (parser)
+                logResponseSize(curl, request, *parser);
+        }
+
+        RequestError error = RetryPolicy::classify(res, responseCode, isCancelled());
+        _retry.recordResult(error);
+        if (!RetryPolicy::isTransient(error))
+            return error;
+
+        Log::writeErrorLog(request + " failed. (" + (res != CURLE_OK ? string(curl_easy_strerror(res)) + " (Curl Error Code: " + std::to_string(res) + ")" : "Curl Response Code " + std::to_string(responseCode)) + ")");
+        //responses that have already been handed over and cannot be discarded would be received twice
+        if ((parser && !parser->reset()) || !_retry.waitForRetry(attempt, _responseHeaders.retryAfter, _cancel))
+            return error;
+    }
+}
+
+bool WebDAV::connectToNetwork()
+{
+    //connecting shows dialogs, therefore the UI thread connects before it hands over the requests
+    if (_onMessage)
+        return true;
+    return Util::connectToNetwork();
+}
+
+int WebDAV::requestProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+    WebDAV *webDAV = static_cast<WebDAV *>(clientp);
+    if (webDAV->isCancelled())
+        return 1;
+
+    if (webDAV->_onProgress && dltotal > 0)
+    {
+        int percentage = dlnow * 100 / dltotal;
+        if (percentage != webDAV->_lastPercentage)
+        {
+            webDAV->_lastPercentage = percentage;
+            webDAV->_onProgress(webDAV->_progressText, percentage);
+        }
+    }
+    return 0;
+}
+
+void WebDAV::setCommonOptions(CURL *curl, const string &url)
+{
+    string post = _username + ":" + _password;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERPWD, post.c_str());
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (_curlShare)
+        curl_easy_setopt(curl, CURLOPT_SHARE, _curlShare);
+
+    if(_ignoreCert)
+    {
+        Log::writeInfoLog("Cert ignored");
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+}
+
+void WebDAV::logResponseSize(CURL *curl, const string &request, const PropfindParser &parser)
+{
+    long headerBytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &headerBytes);
+#if LIBCURL_VERSION_NUM >= 0x073700
+    curl_off_t bodyBytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bodyBytes);
+#else
+    double bodyBytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &bodyBytes);
+#endif
+    Log::writeInfoLog(request + ": " + std::to_string(static_cast<long long>(bodyBytes) + headerBytes) + " bytes on the wire, " + std::to_string(parser.getParsedBytes()) + " bytes decoded");
+}
+
+void WebDAV::trackConnections(CURL *curl)
+{
+    long connects = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects) != CURLE_OK)
+        return;
+
+    if (connects > 0)
+        _openedConnections += connects;
+    else
+        _reusedConnections++;
+}
+
 
 std::vector<WebDAVItem> WebDAV::login(const string &Url, const string &Username, const string &Pass, bool ignoreCert)
 {
@@ -88,6 +311,7 @@ std::vector<WebDAVItem> WebDAV::login(const string &Url, const string &Username,
         _url = Url;
         uuid = Username;
     }
+    _retry = RetryPolicy(_url);
     auto tempPath = NEXTCLOUD_ROOT_PATH + uuid + "/";
     Util::writeConfig<string>("storageLocation", "/mnt/ext1/nextcloud");
     std::vector<WebDAVItem> tempItems = getDataStructure(tempPath);
@@ -120,7 +344,11 @@ void WebDAV::logout(bool deleteFiles)
     }
     fs::remove(CONFIG_PATH.c_str());
     fs::remove((CONFIG_PATH + ".back.").c_str());
+    Util::resetConfig();
+    //the connections are closed, the journal of WAL mode belongs to the deleted DB
     fs::remove(DB_PATH.c_str());
+    fs::remove((DB_PATH + "-wal").c_str());
+    fs::remove((DB_PATH + "-shm").c_str());
     _url = "";
     _password = "";
     _username = "";
@@ -128,111 +356,126 @@ void WebDAV::logout(bool deleteFiles)
 
 vector<WebDAVItem> WebDAV::getDataStructure(const string &pathUrl)
 {
-    string xmlItem = propfind(pathUrl);
-    if (!xmlItem.empty())
-    {
-        string beginItem = "<d:response>";
-        string endItem = "</d:response>";
-        vector<WebDAVItem> tempItems;
-        WebDAVItem tempItem;
-        size_t begin = xmlItem.find(beginItem);
-        size_t end;
+    vector<WebDAVItem> tempItems;
+    const string storageLocation = Util::getConfig<string>("storageLocation");
+    const string prefix = NEXTCLOUD_ROOT_PATH + _username + "/";
 
-        string prefix = NEXTCLOUD_ROOT_PATH + _username + "/";
-        while (begin != std::string::npos)
-        {
-            end = xmlItem.find(endItem);
+    PropfindParser parser([&](const PropfindResponse &response) {
+        tempItems.push_back(createItem(response, storageLocation, prefix));
+    }, [&tempItems]() { tempItems.clear(); });
 
-            //TODO fav is int?
-            //Log::writeInfoLog(Util::getXMLAttribute(xmlItem, "d:favorite"));
+    if (propfind(pathUrl, parser) && !tempItems.empty())
+        return tempItems;
 
-            tempItem.etag = Util::getXMLAttribute(xmlItem, "d:getetag");
-            tempItem.path = Util::getXMLAttribute(xmlItem, "d:href");
-            tempItem.lastEditDate = Util::webDAVStringToTm(Util::getXMLAttribute(xmlItem, "d:getlastmodified"));
+    return {};
+}
 
-            double size = atof(Util::getXMLAttribute(xmlItem, "oc:size").c_str());
-            if (size < 1024)
-                tempItem.size = "< 1 KB";
-            else
-            {
-                double departBy;
-                double tempSize;
-                string unit;
+string WebDAV::getEtag(const string &pathUrl)
+{
+    string etag;
+    PropfindParser parser([&etag](const PropfindResponse &response) {
+        etag = response.etag;
+    }, [&etag]() { etag.clear(); });
 
-                if (size < 1048576)
-                {
-                    departBy = 1024;
-                    unit = "KB";
-                }
-                else if (size < 1073741824)
-                {
-                    departBy = 1048576;
-                    unit = "MB";
-                }
-                else
-                {
-                    departBy = 1073741824;
-                    unit = "GB";
-                }
-                tempSize = round((size / departBy) * 10.0) / 10.0;
-                std::ostringstream stringStream;
-                stringStream << tempSize;
-                tempItem.size = stringStream.str() + " " + unit;
-            }
+    if (!propfind(pathUrl, parser, PropfindProfile::IETAG))
+        return "";
+    return etag;
+}
 
-            //replaces everthing in front of /remote.php as this is already part of the url
-            if (tempItem.path.find(NEXTCLOUD_START_PATH) != 0)
-                tempItem.path.erase(0,tempItem.path.find(NEXTCLOUD_START_PATH));
+string WebDAV::formatSize(double size)
+{
+    string formatted;
+    if (size < 1024)
+        formatted = "< 1 KB";
+    else
+    {
+        double departBy;
+        double tempSize;
+        string unit;
 
-            tempItem.title = tempItem.path;
-            tempItem.localPath = tempItem.path;
-            Util::decodeUrl(tempItem.localPath);
-            if (tempItem.localPath.find(NEXTCLOUD_ROOT_PATH) != string::npos)
-                tempItem.localPath = tempItem.localPath.substr(NEXTCLOUD_ROOT_PATH.length());
-            tempItem.localPath = Util::getConfig<string>("storageLocation") + "/" + tempItem.localPath;
+        if (size < 1048576)
+        {
+            departBy = 1024;
+            unit = "KB";
+        }
+        else if (size < 1073741824)
+        {
+            departBy = 1048576;
+            unit = "MB";
+        }
+        else
+        {
+            departBy = 1073741824;
+            unit = "GB";
+        }
+        tempSize = round((size / departBy) * 10.0) / 10.0;
+        std::ostringstream stringStream;
+        stringStream << tempSize;
+        formatted = stringStream.str() + " " + unit;
+    }
+    return formatted;
+}
 
+WebDAVItem WebDAV::createItem(const PropfindResponse &response, const string &storageLocation, const string &prefix)
+{
+    WebDAVItem tempItem;
 
-            if (tempItem.path.back() == '/')
-            {
-                tempItem.localPath = tempItem.localPath.substr(0, tempItem.localPath.length() - 1);
-                tempItem.type = Itemtype::IFOLDER;
-                tempItem.title = tempItem.title.substr(0, tempItem.path.length() - 1);
-            }
-            else
-            {
-                tempItem.type = Itemtype::IFILE;
-                tempItem.fileType = Util::getXMLAttribute(xmlItem, "d:getcontenttype");
-            }
+    //TODO fav is int?
+    tempItem.etag = response.etag;
+    tempItem.path = response.href;
+    tempItem.lastEditDate = Util::webDAVStringToTm(response.lastModified);
 
-            tempItem.title = tempItem.title.substr(tempItem.title.find_last_of("/") + 1, tempItem.title.length());
-            Util::decodeUrl(tempItem.title);
+    tempItem.size = formatSize(atof(response.size.c_str()));
 
-            string pathDecoded = tempItem.path;
-            Util::decodeUrl(pathDecoded);
-            tempItem.hide = _fileHandler->getHideState(tempItem.type, prefix,pathDecoded, tempItem.title);
+    //replaces everthing in front of /remote.php as this is already part of the url
+    if (tempItem.path.find(NEXTCLOUD_START_PATH) != 0)
+        tempItem.path.erase(0,tempItem.path.find(NEXTCLOUD_START_PATH));
 
-            tempItems.push_back(tempItem);
-            xmlItem = xmlItem.substr(end + endItem.length());
-            begin = xmlItem.find(beginItem);
-        }
+    tempItem.title = tempItem.path;
+    tempItem.localPath = tempItem.path;
+    Util::decodeUrl(tempItem.localPath);
+    if (tempItem.localPath.find(NEXTCLOUD_ROOT_PATH) != string::npos)
+        tempItem.localPath = tempItem.localPath.substr(NEXTCLOUD_ROOT_PATH.length());
+    tempItem.localPath = storageLocation + "/" + tempItem.localPath;
 
-        if (!tempItems.empty())
-            return tempItems;
+    if (tempItem.path.back() == '/' || response.collection)
+    {
+        if (tempItem.path.back() == '/')
+        {
+            tempItem.localPath = tempItem.localPath.substr(0, tempItem.localPath.length() - 1);
+            tempItem.title = tempItem.title.substr(0, tempItem.path.length() - 1);
+        }
+        tempItem.type = Itemtype::IFOLDER;
     }
-    return {};
+    else
+    {
+        tempItem.type = Itemtype::IFILE;
+        tempItem.fileType = response.contentType;
+    }
+
+    tempItem.title = tempItem.title.substr(tempItem.title.find_last_of("/") + 1, tempItem.title.length());
+    Util::decodeUrl(tempItem.title);
+
+    string pathDecoded = tempItem.path;
+    Util::decodeUrl(pathDecoded);
+    tempItem.hideVersion = ExclusionRules::current()->getVersion();
+    tempItem.hide = _fileHandler->getHideState(tempItem.type, prefix,pathDecoded, tempItem.title);
+
+    return tempItem;
 }
 
-string WebDAV::propfind(const string &pathUrl)
+bool WebDAV::propfind(const string &pathUrl, PropfindParser &parser, PropfindProfile profile)
 {
        if (pathUrl.empty() || _username.empty() || _password.empty())
        {
-           Message(ICON_WARNING, "Warning", "Url, username or password is empty.", 2000);
-           return "";
+           showMessage(ICON_WARNING, "Warning", "Url, username or password is empty.", 2000);
+           return false;
        }
 
-       if (!Util::connectToNetwork())
-           return "";
-       ShowHourglassForce();
+       if (!connectToNetwork())
+           return false;
+       if (!_onMessage)
+           ShowHourglassForce();
 
        //TODO for upload
         //get etag from current and then send request with FT_ENC_TAG
@@ -253,171 +496,1154 @@ string WebDAV::propfind(const string &pathUrl)
         //content not modified
 
 
-    string readBuffer;
     CURLcode res;
-    CURL *curl = curl_easy_init();
+    CURL *curl = prepareCurl(_url + pathUrl);
 
     if (curl)
     {
-        string post = _username + ":" + _password;
-
         struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Depth: 1");
-        curl_easy_setopt(curl, CURLOPT_URL, (_url + pathUrl).c_str());
-        curl_easy_setopt(curl, CURLOPT_USERPWD, post.c_str());
+        headers = curl_slist_append(headers, profile == PropfindProfile::IETAG ? "Depth: 0" : "Depth: 1");
+        headers = curl_slist_append(headers, "Content-Type: application/xml; charset=utf-8");
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
         curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PROPFIND");
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Util::writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-        if(_ignoreCert)
-        {
-            Log::writeInfoLog("Cert ignored");
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-        }
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PropfindParser::writeCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &parser);
+        //the multistatus is very repetitive, an empty string offers all encodings curl supports (gzip, deflate)
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
 
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "<\?xml version=\"1.0\" encoding=\"UTF-8\"\?> \
-                                                    <d:propfind xmlns:d=\"DAV:\"><d:prop xmlns:oc=\"http://owncloud.org/ns\"> \
-                                                    <d:getlastmodified/> \
-                                                    <d:getcontenttype/> \
-                                                    <oc:size/> \
-                                                    <d:getetag/> \
-                                                    <oc:favorite/> \
-                                                    </d:prop></d:propfind>");
+        //title and type are taken from the href, the folder itself is part of the response
+        if (profile == PropfindProfile::IETAG)
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                                                       "<d:propfind xmlns:d=\"DAV:\"><d:prop><d:getetag/></d:prop></d:propfind>");
+        else if (profile == PropfindProfile::ICHUNKS)
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                                                       "<d:propfind xmlns:d=\"DAV:\"><d:prop><d:getcontentlength/></d:prop></d:propfind>");
+        else
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                                                       "<d:propfind xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\"><d:prop>"
+                                                       "<d:getlastmodified/><d:getcontenttype/><oc:size/><d:getetag/>"
+                                                       "</d:prop></d:propfind>");
 
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
+        const string request = string(profile == PropfindProfile::IETAG ? "PROPFIND etag " : "PROPFIND ") + pathUrl;
+        long response_code;
+        RequestError error = performRequest(curl, request, &parser, res, response_code);
+        curl_slist_free_all(headers);
 
-        if (res == CURLE_OK)
+        switch (error)
         {
-            long response_code;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-
-            switch (response_code)
-            {
-                case 404:
-                    if (getRootPath().compare( NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("uuid", "")) != 0) {
-                        if (propfind(NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("UUID", "")) != "") {
-                            // Own root path defined
-                            string output;
-                            int dialogResult = DialogSynchro(
-                                ICON_ERROR, 
-                                "Action", 
-                                output.append("The specified start folder does not seem to exist:\n").append(Util::getConfig<std::string>("ex_relativeRootPath", "/")).append("\n\nWhat would you like to do?").c_str(), 
-                                "Reset start folder", "Close App", NULL
-                            );
-                            switch (dialogResult)
+            case RequestError::INONE:
+                if (response_code == 207)
+                    return true;
+                reportError(RequestError::IREJECTED, request, "An unknown error occured. (Curl Response Code " + std::to_string(response_code) + ")");
+                break;
+            case RequestError::INOTFOUND:
+                if (getRootPath().compare( NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("uuid", "")) != 0) {
+                    PropfindParser rootParser;
+                    if (_onMessage) {
+                        //dialogs can only be shown by the UI thread
+                        showMessage(ICON_ERROR, "Error", "The specified start folder does not seem to exist:\n" + Util::getConfig<std::string>("ex_relativeRootPath", "/"), 4000);
+                    } else if (propfind(NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("UUID", ""), rootParser)) {
+                        // Own root path defined
+                        string output;
+                        int dialogResult = DialogSynchro(
+                            ICON_ERROR, 
+                            "Action", 
+                            output.append("The specified start folder does not seem to exist:\n").append(Util::getConfig<std::string>("ex_relativeRootPath", "/")).append("\n\nWhat would you like to do?").c_str(), 
+                            "Reset start folder", "Close App", NULL
+                        );
+                        switch (dialogResult)
+                        {
+                        case 1:
                             {
-                            case 1:
-                                {
-                                    Util::writeConfig<string>("ex_relativeRootPath", "");
-                                    return propfind(NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("UUID", ""));
-                                }
-                                break;
-                            case 2:
-                            default:
-                                CloseApp();
-                                break;
+                                Util::writeConfig<string>("ex_relativeRootPath", "");
+                                return propfind(NEXTCLOUD_ROOT_PATH + Util::getConfig<std::string>("UUID", ""), parser, profile);
                             }
+                            break;
+                        case 2:
+                        default:
+                            CloseApp();
+                            break;
                         }
-                    } else {
-                        Message(ICON_ERROR, "Error", "The URL seems to be incorrect. You can look up the WebDav URL in the settings of the files webapp. ", 4000);
                     }
-                    break;
-                case 401:
-                    Message(ICON_ERROR, "Error", "Username/password incorrect.", 4000);
-                    break;
-                case 207:
-                    return readBuffer;
-                    break;
-                default:
-                    Message(ICON_ERROR, "Error", ("An unknown error occured. (Curl Response Code " + std::to_string(response_code) + ")").c_str(), 5000);
-            }
+                } else {
+                    showMessage(ICON_ERROR, "Error", "The URL seems to be incorrect. You can look up the WebDav URL in the settings of the files webapp. ", 4000);
+                }
+                break;
+            case RequestError::IAUTH:
+                reportError(error, request, "Username/password incorrect.");
+                break;
+            case RequestError::ICANCELLED:
+                Log::writeInfoLog("Request of " + pathUrl + " cancelled");
+                break;
+            default:
+                if (res == CURLE_OK)
+                    reportError(error, request, "An unknown error occured. (Curl Response Code " + std::to_string(response_code) + ")");
+                else
+                    reportError(error, request, std::string("An error occured. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + ")). Please try again.");
+                break;
         }
-        else
+    }
+    return false;
+}
+
+SyncResult WebDAV::getChanges(const string &pathUrl, const string &syncToken, vector<WebDAVItem> &changed, vector<string> &removed, string &newSyncToken)
+{
+    if (!_syncCollectionSupported)
+        return SyncResult::IUNSUPPORTED;
+
+    if (pathUrl.empty() || _username.empty() || _password.empty())
+        return SyncResult::IFAILED;
+
+    if (!connectToNetwork())
+        return SyncResult::IFAILED;
+
+    const string storageLocation = Util::getConfig<string>("storageLocation");
+    const string prefix = NEXTCLOUD_ROOT_PATH + _username + "/";
+    PropfindParser parser([&](const PropfindResponse &response) {
+        WebDAVItem item = createItem(response, storageLocation, prefix);
+        if (response.status.find(" 404") != string::npos)
+            removed.push_back(item.path);
+        else if (item.path != pathUrl)
+            changed.push_back(item);
+    }, [&changed, &removed]() {
+        changed.clear();
+        removed.clear();
+    });
+
+    CURL *curl = prepareCurl(_url + pathUrl);
+    if (!curl)
+        return SyncResult::IFAILED;
+
+    string token = syncToken;
+    Util::encodeXml(token);
+    string body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                  "<d:sync-collection xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">"
+                  "<d:sync-token>" + token + "</d:sync-token>"
+                  "<d:sync-level>infinite</d:sync-level>"
+                  "<d:prop><d:getlastmodified/><d:getcontenttype/><oc:size/><d:getetag/><d:resourcetype/></d:prop>"
+                  "</d:sync-collection>";
+
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, "Depth: 0");
+    headers = curl_slist_append(headers, "Content-Type: application/xml; charset=utf-8");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "REPORT");
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PropfindParser::writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &parser);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+    CURLcode res;
+    long response_code;
+    performRequest(curl, "REPORT sync-collection " + pathUrl, &parser, res, response_code);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK)
+    {
+        Log::writeErrorLog(string("sync-collection failed. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + "))");
+        return SyncResult::IFAILED;
+    }
+
+    switch (response_code)
+    {
+        case 207:
+            if (parser.getSyncToken().empty())
+            {
+                Log::writeInfoLog("sync-collection returned no sync-token, using etags");
+                _syncCollectionSupported = false;
+                return SyncResult::IUNSUPPORTED;
+            }
+            newSyncToken = parser.getSyncToken();
+            Log::writeInfoLog("sync-collection returned " + std::to_string(changed.size()) + " changed and " + std::to_string(removed.size()) + " removed items");
+            return SyncResult::ISUCCESS;
+        case 403:
+        case 409:
+            //the token is no longer valid (precondition valid-sync-token)
+            if (!syncToken.empty())
+            {
+                Log::writeInfoLog("sync-token of " + pathUrl + " is no longer valid");
+                return SyncResult::IINVALIDTOKEN;
+            }
+            _syncCollectionSupported = false;
+            return SyncResult::IUNSUPPORTED;
+        case 400:
+        case 405:
+        case 415:
+        case 501:
+            Log::writeInfoLog("Server does not support sync-collection (Curl Response Code " + std::to_string(response_code) + "), using etags");
+            _syncCollectionSupported = false;
+            return SyncResult::IUNSUPPORTED;
+        default:
+            Log::writeErrorLog("sync-collection failed. (Curl Response Code " + std::to_string(response_code) + ")");
+            return SyncResult::IFAILED;
+    }
+}
+
+SyncResult WebDAV::getTree(const string &pathUrl, const std::function<void(vector<WebDAVItem> &)> &onItems)
+{
+    if (!_depthInfinitySupported)
+        return SyncResult::IUNSUPPORTED;
+
+    string body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                  "<d:propfind xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\"><d:prop>"
+                  "<d:getlastmodified/><d:getcontenttype/><oc:size/><d:getetag/><d:resourcetype/>"
+                  "</d:prop></d:propfind>";
+    SyncResult result = requestTree("PROPFIND", _url + pathUrl, "infinity", body, pathUrl, onItems);
+    if (result == SyncResult::IUNSUPPORTED)
+        _depthInfinitySupported = false;
+    return result;
+}
+
+SyncResult WebDAV::searchTree(const string &pathUrl, const std::function<void(vector<WebDAVItem> &)> &onItems)
+{
+    if (!_searchSupported || pathUrl.find(NEXTCLOUD_DAV_PATH) != 0)
+        return SyncResult::IUNSUPPORTED;
+
+    //the scope is relative to the dav root, e.g. /files/userName/folder/
+    string scope = pathUrl.substr(NEXTCLOUD_DAV_PATH.length());
+    Util::encodeXml(scope);
+    //every item has a content type, folders use httpd/unix-directory
+    string body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                  "<d:searchrequest xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\"><d:basicsearch>"
+                  "<d:select><d:prop><d:getlastmodified/><d:getcontenttype/><oc:size/><d:getetag/><d:resourcetype/></d:prop></d:select>"
+                  "<d:from><d:scope><d:href>" + scope + "</d:href><d:depth>infinity</d:depth></d:scope></d:from>"
+                  "<d:where><d:like><d:prop><d:getcontenttype/></d:prop><d:literal>%</d:literal></d:like></d:where>"
+                  "<d:orderby/>"
+                  "</d:basicsearch></d:searchrequest>";
+    SyncResult result = requestTree("SEARCH", _url + NEXTCLOUD_DAV_PATH + "/", "", body, pathUrl, onItems);
+    if (result == SyncResult::IUNSUPPORTED)
+        _searchSupported = false;
+    return result;
+}
+
+SyncResult WebDAV::requestTree(const string &method, const string &url, const string &depth, const string &body, const string &pathUrl, const std::function<void(vector<WebDAVItem> &)> &onItems)
+{
+    if (pathUrl.empty() || _username.empty() || _password.empty())
+        return SyncResult::IFAILED;
+
+    if (!connectToNetwork())
+        return SyncResult::IFAILED;
+
+    const string storageLocation = Util::getConfig<string>("storageLocation");
+    const string prefix = NEXTCLOUD_ROOT_PATH + _username + "/";
+    vector<WebDAVItem> batch;
+    size_t count = 0;
+    PropfindParser parser([&](const PropfindResponse &response) {
+        //folders are stored with a trailing slash, which not every response contains
+        PropfindResponse member = response;
+        if (member.collection && !member.href.empty() && member.href.back() != '/')
+            member.href += '/';
+        batch.push_back(createItem(member, storageLocation, prefix));
+        if (batch.size() >= TREE_BATCH)
         {
-            string response = std::string("An error occured. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + ")). Please try again.";
-            Log::writeErrorLog(response);
-            Message(ICON_ERROR, "Error", response.c_str(), 4000);
+            count += batch.size();
+            onItems(batch);
+            batch.clear();
         }
+    }, [&batch, &count]() {
+        //batches that have been handed over are saved again with the repeated response
+        batch.clear();
+        count = 0;
+    });
+
+    CURL *curl = prepareCurl(url);
+    if (!curl)
+        return SyncResult::IFAILED;
+
+    struct curl_slist *headers = NULL;
+    if (!depth.empty())
+        headers = curl_slist_append(headers, ("Depth: " + depth).c_str());
+    headers = curl_slist_append(headers, "Content-Type: application/xml; charset=utf-8");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PropfindParser::writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &parser);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+    CURLcode res;
+    long response_code;
+    RequestError error = performRequest(curl, method + " " + depth + " " + pathUrl, &parser, res, response_code);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK)
+    {
+        if (error == RequestError::ICANCELLED)
+            Log::writeInfoLog(method + " of " + pathUrl + " cancelled");
+        else
+            Log::writeErrorLog(method + " of " + pathUrl + " failed. (" + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + "))");
+        return SyncResult::IFAILED;
+    }
+
+    switch (response_code)
+    {
+        case 207:
+            if (!batch.empty())
+            {
+                count += batch.size();
+                onItems(batch);
+            }
+            Log::writeInfoLog(method + " returned " + std::to_string(count) + " items below " + pathUrl);
+            return SyncResult::ISUCCESS;
+        case 400:
+        case 403:
+        case 405:
+        case 415:
+        case 422:
+        case 501:
+            Log::writeInfoLog("Server does not allow " + method + " " + depth + " (Curl Response Code " + std::to_string(response_code) + ")");
+            return SyncResult::IUNSUPPORTED;
+        default:
+            Log::writeErrorLog(method + " of " + pathUrl + " failed. (Curl Response Code " + std::to_string(response_code) + ")");
+            return SyncResult::IFAILED;
     }
-    return "";
 }
 
 bool WebDAV::get(WebDAVItem &item)
 {
     if (item.state == FileState::ISYNCED)
     {
-        UpdateProgressbar(("The newest version of file " + item.path + " is already downloaded.").c_str(), 0);
+        showProgress(("The newest version of file " + item.path + " is already downloaded.").c_str(), 0);
         return false;
     }
 
     if (item.path.empty())
     {
-        Message(ICON_ERROR, "Error", "Download path is not set, therefore cannot download the file.", 2000);
+        showMessage(ICON_ERROR, "Error", "Download path is not set, therefore cannot download the file.", 2000);
         return false;
     }
 
-    if (!Util::connectToNetwork())
+    if (!connectToNetwork())
         return false;
 
-    ShowHourglassForce();
+    if (!_onMessage)
+        ShowHourglassForce();
 
-    UpdateProgressbar(("Starting Download to " + item.localPath).c_str(), 0);
-    CURLcode res;
-    CURL *curl = curl_easy_init();
+    showProgress(("Starting Download to " + item.localPath).c_str(), 0);
+    const string request = "GET " + item.path;
+    for (int attempt = 1;; attempt++)
+    {
+        CURL *curl = prepareCurl(_url + item.path);
+        if (!curl)
+            return false;
+        if (!_retry.allowRequest())
+        {
+            reportError(RequestError::IUNAVAILABLE, request, "The server does not respond. Please try again later.");
+            return false;
+        }
 
-    if (curl)
+        DownloadTransfer transfer;
+        transfer.item = &item;
+        transfer.curl = curl;
+        if (!startTransfer(transfer))
+        {
+            showMessage(ICON_ERROR, "Error", ("Could not write to " + item.localPath).c_str(), 2000);
+            return false;
+        }
+
+        //with handlers the progress is reported by requestProgress
+        if (!_onProgress)
+        {
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
+            curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, Util::progress_callback);
+        }
+        CURLcode res = curl_easy_perform(curl);
+        trackConnections(curl);
+
+        long response_code;
+        bool finished = finishTransfer(transfer, res, response_code);
+        RequestError error = finished ? RequestError::INONE : RetryPolicy::classify(res, response_code, isCancelled());
+        _retry.recordResult(error);
+        if (finished)
+            return true;
+
+        //the part file is kept unless it did not fit, so the next attempt continues where this one stopped
+        if (RetryPolicy::isTransient(error) && _retry.waitForRetry(attempt, transfer.responseHeaders.retryAfter, _cancel))
+            continue;
+
+        switch (error)
+        {
+            case RequestError::ICANCELLED:
+                Log::writeInfoLog("Download of " + item.path + " cancelled");
+                break;
+            case RequestError::IAUTH:
+                reportError(error, request, "Username/password incorrect.");
+                break;
+            default:
+                if (res == CURLE_OK)
+                    reportError(error, request, "An unknown error occured. (Curl Response Code " + std::to_string(response_code) + ")");
+                else if (res == 60)
+                    reportError(error, request, "Seems as if you are using Let's Encrypt Certs. Please follow the guide on Github (https://github.com/JuanJakobo/Pocketbook-Nextcloud-Client) to use a custom Cert Store on PB.");
+                else
+                    reportError(error, request, std::string("An error occured. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + ")). Please try again.");
+                break;
+        }
+        return false;
+    }
+}
+
+bool WebDAV::startTransfer(DownloadTransfer &transfer)
+{
+    WebDAVItem &item = *transfer.item;
+
+    //a part file of an interrupted download is continued
+    transfer.partPath = item.localPath + ".part";
+    struct stat partStat;
+    transfer.resumeFrom = (stat(transfer.partPath.c_str(), &partStat) == 0) ? partStat.st_size : 0;
+    transfer.fp = iv_fopen(transfer.partPath.c_str(), transfer.resumeFrom > 0 ? "ab" : "wb");
+    if (!transfer.fp)
+    {
+        Log::writeErrorLog("Could not open " + transfer.partPath + " for writing");
+        return false;
+    }
+
+    setCommonOptions(transfer.curl, _url + item.path);
+    curl_easy_setopt(transfer.curl, CURLOPT_WRITEFUNCTION, WebDAV::writeTransfer);
+    curl_easy_setopt(transfer.curl, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(transfer.curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(transfer.curl, CURLOPT_HEADERFUNCTION, WebDAV::readHeader);
+    curl_easy_setopt(transfer.curl, CURLOPT_HEADERDATA, &transfer.responseHeaders);
+
+    string etag = item.etag;
+    Util::decodeXml(etag);
+    if (transfer.resumeFrom > 0)
     {
-        string post = _username + std::string(":") + _password;
+        Log::writeInfoLog("Resuming download of " + item.path + " at byte " + std::to_string(transfer.resumeFrom));
+        //unlike CURLOPT_RESUME_FROM_LARGE a range accepts a 200 with the whole file, writeTransfer starts the part file again then
+        curl_easy_setopt(transfer.curl, CURLOPT_RANGE, (std::to_string(transfer.resumeFrom) + "-").c_str());
+        //if the file changed in the meantime the server sends the whole file
+        if (!etag.empty())
+            transfer.headers = curl_slist_append(transfer.headers, ("If-Range: " + etag).c_str());
+    }
+
+    //the server answers with 304 if the local copy is still up to date
+    if (!item.localEtag.empty() && iv_access(item.localPath.c_str(), R_OK) == 0)
+    {
+        string localEtag = item.localEtag;
+        Util::decodeXml(localEtag);
+        transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + localEtag).c_str());
+    }
+    if (transfer.headers)
+        curl_easy_setopt(transfer.curl, CURLOPT_HTTPHEADER, transfer.headers);
+
+    return true;
+}
+
+bool WebDAV::finishTransfer(DownloadTransfer &transfer, CURLcode res, long &responseCode)
+{
+    WebDAVItem &item = *transfer.item;
+
+    if (transfer.fp)
+    {
+        iv_fclose(transfer.fp);
+        transfer.fp = nullptr;
+    }
+    curl_slist_free_all(transfer.headers);
+    transfer.headers = nullptr;
+
+    responseCode = 0;
+    if (res == CURLE_RANGE_ERROR)
+    {
+        //the next attempt starts from the beginning
+        remove(transfer.partPath.c_str());
+        Log::writeErrorLog("Download of " + item.path + " could not be resumed, starting again");
+        return false;
+    }
+    if (res != CURLE_OK)
+    {
+        //keep the part file to resume the download the next time
+        Log::writeErrorLog("Download of " + item.path + " failed. (" + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + "))");
+        return false;
+    }
+
+    curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    switch (responseCode)
+    {
+        case 200:
+        case 206:
+            if (rename(transfer.partPath.c_str(), item.localPath.c_str()) != 0)
+            {
+                Log::writeErrorLog("Could not move " + transfer.partPath + " to " + item.localPath);
+                return false;
+            }
+            item.localEtag = item.etag;
+            Log::writeInfoLog("finished download of " + item.title + " to " + item.localPath);
+            return true;
+        case 304:
+            remove(transfer.partPath.c_str());
+            item.localEtag = item.etag;
+            Log::writeInfoLog(item.localPath + " is unchanged, skipping download");
+            return true;
+        case 416:
+            //the part file does not fit to the file on the server, the next attempt starts from the beginning
+            remove(transfer.partPath.c_str());
+            break;
+        default:
+            if (transfer.resumeFrom == 0)
+                remove(transfer.partPath.c_str());
+            break;
+    }
+    Log::writeErrorLog("Download of " + item.path + " failed. (Curl Response Code " + std::to_string(responseCode) + ")");
+    return false;
+}
 
-        FILE *fp;
-        fp = iv_fopen(item.localPath.c_str(), "wb");
+size_t WebDAV::writeTransfer(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+    DownloadTransfer *transfer = static_cast<DownloadTransfer *>(userp);
 
-        curl_easy_setopt(curl, CURLOPT_URL, (_url + item.path).c_str());
-        curl_easy_setopt(curl, CURLOPT_USERPWD, post.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Util::writeData);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
-        curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, Util::progress_callback);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        if(_ignoreCert)
+    long responseCode = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    if (responseCode != transfer->responseCode)
+    {
+        transfer->responseCode = responseCode;
+        if (responseCode == 200 && transfer->resumeFrom > 0)
         {
-            Log::writeInfoLog("Cert ignored");
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+            //If-Range did not match, therefore the whole file is send again
+            iv_fclose(transfer->fp);
+            transfer->fp = iv_fopen(transfer->partPath.c_str(), "wb");
+            transfer->resumeFrom = 0;
         }
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        iv_fclose(fp);
+    }
 
-        if (res == CURLE_OK)
+    //bodies of redirects and errors must not end up in the file
+    if ((responseCode != 200 && responseCode != 206) || !transfer->fp)
+        return size * nmemb;
+
+    return iv_fwrite(ptr, size, nmemb, transfer->fp) * size;
+}
+
+int WebDAV::transferProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+    DownloadTransfer *transfer = static_cast<DownloadTransfer *>(clientp);
+    transfer->dltotal = dltotal;
+    transfer->dlnow = dlnow;
+    //aborts the transfer before the next chunk is received
+    return (transfer->cancel && transfer->cancel->load()) ? 1 : 0;
+}
+
+size_t WebDAV::prepareTransferHandles(size_t parallel)
+{
+    if (!_curlMulti)
+    {
+        _curlMulti = curl_multi_init();
+        if (!_curlMulti)
+            return 0;
+    }
+
+    curl_multi_setopt(_curlMulti, CURLMOPT_MAX_HOST_CONNECTIONS, (long)parallel);
+    while (_transferHandles.size() < parallel)
+    {
+        CURL *handle = curl_easy_init();
+        if (!handle)
+            break;
+        _transferHandles.push_back(handle);
+    }
+    return std::min(parallel, _transferHandles.size());
+}
+
+int WebDAV::getMultiple(vector<WebDAVItem> &items, const std::function<void(WebDAVItem &)> &onFinished)
+{
+    if (items.empty())
+        return 0;
+
+    if (!connectToNetwork())
+        return items.size();
+
+    size_t parallel = prepareTransferHandles(std::max(1, Util::getConfig<int>("parallelDownloads", DOWNLOAD_MAX_PARALLEL)));
+    if (parallel == 0)
+        return items.size();
+    _downloadConcurrency.setMax(parallel);
+
+    Log::writeInfoLog("Starting download of " + std::to_string(items.size()) + " files with " + std::to_string(_downloadConcurrency.getLimit()) + " of at most " + std::to_string(parallel) + " parallel transfers");
+    const auto start = std::chrono::steady_clock::now();
+    //bytes of the finished transfers, the running ones are added to measure the throughput
+    curl_off_t receivedBytes = 0;
+    _downloadConcurrency.start(receivedBytes);
+
+    vector<CURL *> freeHandles(_transferHandles.begin(), _transferHandles.begin() + parallel);
+    vector<std::unique_ptr<DownloadTransfer>> active;
+    //files that failed with a transient error are started again once their backoff is over
+    vector<std::pair<WebDAVItem *, std::chrono::steady_clock::time_point>> retries;
+    std::unordered_map<WebDAVItem *, int> attempts;
+    size_t next = 0;
+    size_t finished = 0;
+    int failed = 0;
+    int lastPercentage = -1;
+    bool abort = false;
+    bool unreachable = false;
+    int running = 0;
+
+    while (!abort && (next < items.size() || !active.empty() || !retries.empty()))
+    {
+        //no new transfers are started while the server does not respond
+        if (!_retry.allowRequest())
         {
-            long response_code;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+            if (!unreachable)
+                Log::writeErrorLog("Server does not respond, no further downloads are started");
+            unreachable = true;
+            if (active.empty())
+                break;
+        }
 
-            switch (response_code)
+        //fill up the slots the controller allows
+        while (!unreachable && !freeHandles.empty() && active.size() < static_cast<size_t>(_downloadConcurrency.getLimit()))
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto retry = std::find_if(retries.begin(), retries.end(), [&now](const std::pair<WebDAVItem *, std::chrono::steady_clock::time_point> &entry) { return entry.second <= now; });
+            WebDAVItem *nextItem = nullptr;
+            if (retry != retries.end())
+            {
+                nextItem = retry->first;
+                retries.erase(retry);
+            }
+            else if (next < items.size())
+            {
+                nextItem = &items.at(next++);
+            }
+            else
             {
-            case 200:
-                Log::writeInfoLog("finished download of " + item.title + " to " + item.localPath);
-                return true;
                 break;
-            case 401:
-                Message(ICON_ERROR, "Error", "Username/password incorrect.", 2000);
+            }
+
+            WebDAVItem &item = *nextItem;
+            if (item.path.empty())
+            {
+                Log::writeErrorLog("Download path is not set for " + item.localPath);
+                failed++;
+                finished++;
+                continue;
+            }
+
+            CURL *curl = freeHandles.back();
+            curl_easy_reset(curl);
+
+            std::unique_ptr<DownloadTransfer> transfer(new DownloadTransfer());
+            transfer->item = &item;
+            transfer->curl = curl;
+            transfer->cancel = _cancel;
+            if (!startTransfer(*transfer))
+            {
+                failed++;
+                finished++;
+                continue;
+            }
+            freeHandles.pop_back();
+
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, WebDAV::transferProgress);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer.get());
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer.get());
+            curl_multi_add_handle(_curlMulti, curl);
+            Log::writeInfoLog("started download of " + item.path + " to " + item.localPath);
+            active.push_back(std::move(transfer));
+        }
+
+        curl_multi_perform(_curlMulti, &running);
+
+        CURLMsg *msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(_curlMulti, &msgsLeft)))
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CURL *curl = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            DownloadTransfer *transfer;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &transfer);
+            WebDAVItem &item = *transfer->item;
+
+            curl_multi_remove_handle(_curlMulti, curl);
+            trackConnections(curl);
+            receivedBytes += transfer->dlnow;
+
+            //time from sending the request until the first byte of the response
+#if LIBCURL_VERSION_NUM >= 0x073d00
+            curl_off_t pretransfer = 0;
+            curl_off_t starttransfer = 0;
+            curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+            _downloadConcurrency.addRtt((starttransfer - pretransfer) / 1000.0);
+#else
+            double pretransfer = 0;
+            double starttransfer = 0;
+            curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+            _downloadConcurrency.addRtt((starttransfer - pretransfer) * 1000.0);
+#endif
+
+            long response_code;
+            bool downloaded = finishTransfer(*transfer, res, response_code);
+            RequestError error = downloaded ? RequestError::INONE : RetryPolicy::classify(res, response_code, isCancelled());
+            _retry.recordResult(error);
+            //rate limits and timeouts mean that there are too many transfers for the server or the connection
+            if (RetryPolicy::isTransient(error) && error != RequestError::IRANGE)
+                _downloadConcurrency.onCongestion();
+            if (downloaded)
+            {
+                finished++;
+                onFinished(item);
+            }
+            else
+            {
+                long delay = RetryPolicy::isTransient(error) ? _retry.getDelay(++attempts[&item], transfer->responseHeaders.retryAfter) : -1;
+                if (delay >= 0)
+                {
+                    //the part file is kept unless it did not fit, so the next attempt continues where this one stopped
+                    Log::writeInfoLog("Retrying download of " + item.path + " in " + std::to_string(delay) + " ms");
+                    retries.emplace_back(&item, std::chrono::steady_clock::now() + std::chrono::milliseconds(delay));
+                }
+                else
+                {
+                    failed++;
+                    finished++;
+                    if (error != RequestError::ICANCELLED)
+                        _report.add(error, "GET " + item.path);
+                    if (error == RequestError::IAUTH)
+                        abort = true;
+                }
+            }
+
+            freeHandles.push_back(curl);
+            active.erase(std::remove_if(active.begin(), active.end(), [transfer](const std::unique_ptr<DownloadTransfer> &t) { return t.get() == transfer; }), active.end());
+        }
+
+        //aggregated progress of all files
+        double progress = finished;
+        curl_off_t bytes = receivedBytes;
+        for (const auto &transfer : active)
+        {
+            bytes += transfer->dlnow;
+            if (transfer->dltotal > 0)
+                progress += (double)transfer->dlnow / transfer->dltotal;
+        }
+        //a slot freed by a finished transfer is filled again at the begin of the next loop, so the window goes on
+        //only at the end of the batch or while retries wait for their backoff the free slots say nothing about the level
+        auto now = std::chrono::steady_clock::now();
+        bool refill = !unreachable && (next < items.size() || std::any_of(retries.begin(), retries.end(), [&now](const std::pair<WebDAVItem *, std::chrono::steady_clock::time_point> &entry) { return entry.second <= now; }));
+        if (refill || active.size() >= static_cast<size_t>(_downloadConcurrency.getLimit()))
+            _downloadConcurrency.update(bytes);
+        else
+            _downloadConcurrency.start(bytes);
+        int percentage = round(progress / items.size() * 100);
+        if (percentage != lastPercentage)
+        {
+            lastPercentage = percentage;
+            showProgress(("Downloading files (" + std::to_string(finished) + "/" + std::to_string(items.size()) + ")").c_str(), percentage);
+        }
+
+        if (!active.empty())
+            curl_multi_wait(_curlMulti, NULL, 0, 1000, NULL);
+        else if (!retries.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (isCancelled())
+        {
+            Log::writeInfoLog("Download cancelled, " + std::to_string(finished) + " of " + std::to_string(items.size()) + " files finished");
+            abort = true;
+        }
+    }
+
+    //cancel the transfers that are still running
+    for (const auto &transfer : active)
+    {
+        long response_code;
+        curl_multi_remove_handle(_curlMulti, transfer->curl);
+        finishTransfer(*transfer, CURLE_ABORTED_BY_CALLBACK, response_code);
+        failed++;
+    }
+    //files that have not been started or wait for a retry
+    size_t notStarted = retries.size() + (items.size() - next);
+    failed += notStarted;
+    if (unreachable && notStarted > 0 && !isCancelled())
+    {
+        for (const auto &retry : retries)
+            _report.add(RequestError::IUNAVAILABLE, "GET " + retry.first->path);
+        for (size_t i = next; i < items.size(); i++)
+            _report.add(RequestError::IUNAVAILABLE, "GET " + items.at(i).path);
+    }
+
+    for (const auto &transfer : active)
+        receivedBytes += transfer->dlnow;
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    Log::writeInfoLog("Downloaded " + std::to_string(receivedBytes / 1024) + " KB in " + std::to_string(duration) + " ms (" + std::to_string(duration > 0 ? static_cast<long>(receivedBytes * 1000 / 1024 / duration) : 0) + " KB/s), ending with " + std::to_string(_downloadConcurrency.getLimit()) + " parallel transfers");
+
+    if (failed > 0 && !isCancelled())
+    {
+        Log::writeErrorLog(std::to_string(failed) + " of " + std::to_string(items.size()) + " files could not be downloaded");
+        //with handlers the report is shown once the whole batch is finished
+        if (!_onMessage && !_report.empty())
+        {
+            showMessage(ICON_ERROR, "Error", _report.summary(), 4000);
+            _report.clear();
+        }
+    }
+
+    return failed;
+}
+
+string WebDAV::getRemotePath(const string &localPath, bool folder)
+{
+    string storageLocation = Util::getConfig<string>("storageLocation");
+    string relative = localPath.substr(std::min(localPath.length(), storageLocation.length() + 1));
+
+    //the server keeps these characters in the hrefs of its responses, everything else is percent-encoded
+    static const char hex[] = "0123456789ABCDEF";
+    string path = NEXTCLOUD_ROOT_PATH;
+    for (unsigned char c : relative)
+    {
+        if (isalnum(c) || strchr("-._~()/:@", c))
+        {
+            path += c;
+        }
+        else
+        {
+            path += '%';
+            path += hex[c >> 4];
+            path += hex[c & 15];
+        }
+    }
+    if (folder && path.back() != '/')
+        path += '/';
+    return path;
+}
+
+RequestError WebDAV::sendRequest(const string &method, const string &pathUrl, const vector<string> &headers, long &responseCode)
+{
+    responseCode = 0;
+    CURL *curl = prepareCurl(_url + pathUrl);
+    if (!curl)
+        return RequestError::IFATAL;
+
+    struct curl_slist *headerList = NULL;
+    for (const auto &header : headers)
+        headerList = curl_slist_append(headerList, header.c_str());
+    string response;
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Util::writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+
+    CURLcode res;
+    RequestError error = performRequest(curl, method + " " + pathUrl, nullptr, res, responseCode);
+    curl_slist_free_all(headerList);
+    if (res != CURLE_OK && error != RequestError::ICANCELLED)
+        Log::writeErrorLog(method + " of " + pathUrl + " failed. (" + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + "))");
+    return error;
+}
+
+bool WebDAV::createFolders(const vector<string> &paths)
+{
+    if (paths.empty())
+        return true;
+    if (!connectToNetwork())
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &path : paths)
+    {
+        long responseCode;
+        RequestError error = sendRequest("MKCOL", path, {}, responseCode);
+        //405 is send if the folder exists already
+        if (error == RequestError::INONE && (responseCode == 201 || responseCode == 405))
+            continue;
+        if (error == RequestError::IREJECTED && responseCode == 405)
+            continue;
+
+        if (error != RequestError::ICANCELLED)
+            reportError(error == RequestError::INONE ? RequestError::IREJECTED : error, "MKCOL " + path, "Could not create the folder " + path + " (Curl Response Code " + std::to_string(responseCode) + ")");
+        return false;
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    Log::writeInfoLog("Created " + std::to_string(paths.size()) + " folders in " + std::to_string(duration.count()) + " ms");
+    return true;
+}
+
+bool WebDAV::put(WebDAVItem &item)
+{
+    struct stat fileStat;
+    if (item.path.empty() || stat(item.localPath.c_str(), &fileStat) != 0)
+    {
+        reportError(RequestError::IFATAL, "PUT " + item.localPath, "Could not read " + item.localPath);
+        return false;
+    }
+    if (!connectToNetwork())
+        return false;
+
+    _progressText = "Uploading " + item.title;
+    if (fileStat.st_size > UPLOAD_CHUNK_SIZE)
+        return putChunked(item, fileStat.st_size, fileStat.st_mtime);
+
+    //a file that has been created on the server in the meantime is not overwritten
+    vector<UploadChunk> chunks(1);
+    chunks.at(0).url = _url + item.path;
+    chunks.at(0).length = fileStat.st_size;
+    vector<string> headers{"If-None-Match: *", "X-OC-Mtime: " + std::to_string(fileStat.st_mtime)};
+    if (!sendChunks(item.localPath, chunks, headers, fileStat.st_size))
+        return false;
+
+    item.etag = chunks.at(0).responseHeaders.etag;
+    Util::encodeXml(item.etag);
+    Log::writeInfoLog("Uploaded " + item.localPath + " to " + item.path);
+    return true;
+}
+
+bool WebDAV::putChunked(WebDAVItem &item, curl_off_t size, time_t mtime)
+{
+    //the upload folder belongs to this version of the file, so an interrupted upload is continued with it
+    string user = item.path.substr(NEXTCLOUD_ROOT_PATH.length());
+    user = user.substr(0, user.find('/'));
+    std::ostringstream transferId;
+    transferId << "pocketbook-" << std::hex << std::hash<string>()(item.path + ":" + std::to_string(size) + ":" + std::to_string(mtime));
+    const string uploadPath = NEXTCLOUD_UPLOADS_PATH + user + "/" + transferId.str();
+    const string destination = "Destination: " + _url + item.path;
+    const string totalLength = "OC-Total-Length: " + std::to_string(size);
+
+    long responseCode;
+    RequestError error = sendRequest("MKCOL", uploadPath, {destination}, responseCode);
+    std::map<string, curl_off_t> uploaded;
+    if ((error == RequestError::INONE || error == RequestError::IREJECTED) && responseCode == 405)
+    {
+        PropfindParser parser([&uploaded](const PropfindResponse &response) {
+            string name = response.href.substr(response.href.find_last_of('/') + 1);
+            if (!name.empty())
+                uploaded[name] = atoll(response.size.c_str());
+        });
+        if (!propfind(uploadPath + "/", parser, PropfindProfile::ICHUNKS))
+            return false;
+    }
+    else if (error != RequestError::INONE || responseCode != 201)
+    {
+        if (error != RequestError::ICANCELLED)
+            reportError(error == RequestError::INONE ? RequestError::IREJECTED : error, "MKCOL " + uploadPath, "Could not start the upload of " + item.title + " (Curl Response Code " + std::to_string(responseCode) + ")");
+        return false;
+    }
+
+    //the chunks are numbered from 1, chunks that are complete on the server are not sent again
+    vector<UploadChunk> chunks;
+    for (curl_off_t offset = 0, number = 1; offset < size; offset += UPLOAD_CHUNK_SIZE, number++)
+    {
+        UploadChunk chunk;
+        chunk.url = _url + uploadPath + "/" + std::to_string(number);
+        chunk.offset = offset;
+        chunk.length = std::min<curl_off_t>(UPLOAD_CHUNK_SIZE, size - offset);
+        auto stored = uploaded.find(std::to_string(number));
+        if (stored == uploaded.end() || stored->second != chunk.length)
+            chunks.push_back(chunk);
+    }
+    size_t total = (size + UPLOAD_CHUNK_SIZE - 1) / UPLOAD_CHUNK_SIZE;
+    if (chunks.size() < total)
+        Log::writeInfoLog("Resuming upload of " + item.path + ", " + std::to_string(total - chunks.size()) + " of " + std::to_string(total) + " chunks are on the server");
+
+    if (!sendChunks(item.localPath, chunks, {destination, totalLength}, size))
+        return false;
+
+    //the server assembles the chunks, the response contains the etag of the file
+    //like the single PUT a file that has been created on the server in the meantime is not overwritten
+    error = sendRequest("MOVE", uploadPath + "/.file", {destination, totalLength, "Overwrite: F", "X-OC-Mtime: " + std::to_string(mtime)}, responseCode);
+    if (error == RequestError::IREJECTED && responseCode == 412)
+    {
+        reportError(RequestError::IREJECTED, "MOVE " + uploadPath, "The file " + item.localPath + " exists on the server already.");
+        //the chunks can not be used anymore
+        sendRequest("DELETE", uploadPath, {}, responseCode);
+        return false;
+    }
+    if (error != RequestError::INONE || (responseCode != 201 && responseCode != 204))
+    {
+        if (error != RequestError::ICANCELLED)
+            reportError(error == RequestError::INONE ? RequestError::IREJECTED : error, "MOVE " + uploadPath, "Could not finish the upload of " + item.title + " (Curl Response Code " + std::to_string(responseCode) + ")");
+        return false;
+    }
+
+    item.etag = _responseHeaders.etag;
+    Util::encodeXml(item.etag);
+    Log::writeInfoLog("Uploaded " + item.localPath + " in " + std::to_string(total) + " chunks to " + item.path);
+    return true;
+}
+
+bool WebDAV::sendChunks(const string &localPath, vector<UploadChunk> &chunks, const vector<string> &headers, curl_off_t total)
+{
+    size_t parallel = prepareTransferHandles(std::max(1, Util::getConfig<int>("parallelUploads", UPLOAD_PARALLEL)));
+    if (parallel == 0)
+        return false;
+
+    //the bytes of the chunks that are not sent are already on the server
+    curl_off_t done = total;
+    for (const auto &chunk : chunks)
+        done -= chunk.length;
+
+    vector<CURL *> freeHandles(_transferHandles.begin(), _transferHandles.begin() + parallel);
+    vector<UploadChunk *> active;
+    vector<std::pair<UploadChunk *, std::chrono::steady_clock::time_point>> retries;
+    size_t next = 0;
+    bool failed = false;
+    int running = 0;
+    int lastPercentage = -1;
+
+    while (!failed && (next < chunks.size() || !active.empty() || !retries.empty()))
+    {
+        if (!_retry.allowRequest())
+        {
+            reportError(RequestError::IUNAVAILABLE, "PUT " + localPath, "The server does not respond. Please try again later.");
+            failed = true;
+            break;
+        }
+
+        while (!freeHandles.empty())
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto retry = std::find_if(retries.begin(), retries.end(), [&now](const std::pair<UploadChunk *, std::chrono::steady_clock::time_point> &entry) { return entry.second <= now; });
+            UploadChunk *chunk = nullptr;
+            if (retry != retries.end())
+            {
+                chunk = retry->first;
+                retries.erase(retry);
+            }
+            else if (next < chunks.size())
+            {
+                chunk = &chunks.at(next++);
+            }
+            else
+            {
                 break;
-            default:
-                Message(ICON_ERROR, "Error", ("An unknown error occured. (Curl Response Code " + std::to_string(response_code) + ")").c_str(), 2000);
+            }
+
+            chunk->fp = iv_fopen(localPath.c_str(), "rb");
+            if (!chunk->fp || fseeko(chunk->fp, chunk->offset, SEEK_SET) != 0)
+            {
+                if (chunk->fp)
+                    iv_fclose(chunk->fp);
+                chunk->fp = nullptr;
+                reportError(RequestError::IFATAL, "PUT " + localPath, "Could not read " + localPath);
+                failed = true;
                 break;
             }
+            chunk->sent = 0;
+            chunk->ulnow = 0;
+            chunk->cancel = _cancel;
+            chunk->responseHeaders = ResponseHeaders();
+            chunk->curl = freeHandles.back();
+            freeHandles.pop_back();
+
+            curl_easy_reset(chunk->curl);
+            setCommonOptions(chunk->curl, chunk->url);
+            for (const auto &header : headers)
+                chunk->headers = curl_slist_append(chunk->headers, header.c_str());
+            curl_easy_setopt(chunk->curl, CURLOPT_HTTPHEADER, chunk->headers);
+            curl_easy_setopt(chunk->curl, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt(chunk->curl, CURLOPT_READFUNCTION, WebDAV::readChunk);
+            curl_easy_setopt(chunk->curl, CURLOPT_READDATA, chunk);
+            curl_easy_setopt(chunk->curl, CURLOPT_INFILESIZE_LARGE, chunk->length);
+            curl_easy_setopt(chunk->curl, CURLOPT_HEADERFUNCTION, WebDAV::readHeader);
+            curl_easy_setopt(chunk->curl, CURLOPT_HEADERDATA, &chunk->responseHeaders);
+            curl_easy_setopt(chunk->curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(chunk->curl, CURLOPT_XFERINFOFUNCTION, WebDAV::chunkProgress);
+            curl_easy_setopt(chunk->curl, CURLOPT_XFERINFODATA, chunk);
+            curl_easy_setopt(chunk->curl, CURLOPT_PRIVATE, chunk);
+            curl_multi_add_handle(_curlMulti, chunk->curl);
+            active.push_back(chunk);
         }
-        else
+        if (failed)
+            break;
+
+        curl_multi_perform(_curlMulti, &running);
+
+        CURLMsg *msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(_curlMulti, &msgsLeft)))
         {
-            string response = std::string("An error occured. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + ")). Please try again.";
-            if (res == 60)
-                response = "Seems as if you are using Let's Encrypt Certs. Please follow the guide on Github (https://github.com/JuanJakobo/Pocketbook-Nextcloud-Client) to use a custom Cert Store on PB.";
-            Message(ICON_ERROR, "Error", response.c_str(), 4000);
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            UploadChunk *chunk;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &chunk);
+            CURLcode res = msg->data.result;
+            long responseCode = 0;
+            if (res == CURLE_OK)
+                curl_easy_getinfo(chunk->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+            curl_multi_remove_handle(_curlMulti, chunk->curl);
+            trackConnections(chunk->curl);
+            iv_fclose(chunk->fp);
+            chunk->fp = nullptr;
+            curl_slist_free_all(chunk->headers);
+            chunk->headers = nullptr;
+            freeHandles.push_back(chunk->curl);
+            active.erase(std::remove(active.begin(), active.end(), chunk), active.end());
+
+            RequestError error = RetryPolicy::classify(res, responseCode, isCancelled());
+            _retry.recordResult(error);
+            if (error == RequestError::INONE && responseCode >= 200 && responseCode < 300)
+            {
+                done += chunk->length;
+                continue;
+            }
+
+            long delay = RetryPolicy::isTransient(error) ? _retry.getDelay(++chunk->attempts, chunk->responseHeaders.retryAfter) : -1;
+            if (delay >= 0)
+            {
+                Log::writeInfoLog("Retrying upload to " + chunk->url + " in " + std::to_string(delay) + " ms");
+                retries.emplace_back(chunk, std::chrono::steady_clock::now() + std::chrono::milliseconds(delay));
+                continue;
+            }
+
+            failed = true;
+            if (error == RequestError::ICANCELLED)
+                Log::writeInfoLog("Upload of " + localPath + " cancelled");
+            else if (responseCode == 412)
+                reportError(RequestError::IREJECTED, "PUT " + localPath, "The file " + localPath + " exists on the server already.");
+            else if (res != CURLE_OK)
+                reportError(error, "PUT " + localPath, std::string("An error occured. (") + curl_easy_strerror(res) + " (Curl Error Code: " + std::to_string(res) + ")). Please try again.");
+            else
+                reportError(error == RequestError::INONE ? RequestError::IREJECTED : error, "PUT " + localPath, "An unknown error occured. (Curl Response Code " + std::to_string(responseCode) + ")");
         }
+
+        curl_off_t progress = done;
+        for (const auto &chunk : active)
+            progress += chunk->ulnow;
+        int percentage = total > 0 ? progress * 100 / total : 100;
+        if (percentage != lastPercentage)
+        {
+            lastPercentage = percentage;
+            showProgress(_progressText, percentage);
+        }
+
+        if (!active.empty())
+            curl_multi_wait(_curlMulti, NULL, 0, 1000, NULL);
+        else if (!retries.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (isCancelled())
+            failed = true;
     }
-    return false;
+
+    //chunks that are still running are sent again with the next attempt
+    for (auto chunk : active)
+    {
+        curl_multi_remove_handle(_curlMulti, chunk->curl);
+        iv_fclose(chunk->fp);
+        chunk->fp = nullptr;
+        curl_slist_free_all(chunk->headers);
+        chunk->headers = nullptr;
+    }
+    return !failed;
+}
+
+size_t WebDAV::readChunk(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    UploadChunk *chunk = static_cast<UploadChunk *>(userp);
+    size_t length = std::min<curl_off_t>(size * nitems, chunk->length - chunk->sent);
+    if (length == 0)
+        return 0;
+    size_t read = iv_fread(buffer, 1, length, chunk->fp);
+    chunk->sent += read;
+    return read;
+}
+
+int WebDAV::chunkProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+    UploadChunk *chunk = static_cast<UploadChunk *>(clientp);
+    chunk->ulnow = ulnow;
+    //aborts the transfer before the next chunk is sent
+    return (chunk->cancel && chunk->cancel->load()) ? 1 : 0;
 }
@@ -12,15 +12,64 @@
 
 #include "webDAVModel.h"
 #include "fileHandler.h"
+#include "propfindParser.h"
+#include "retryPolicy.h"
+#include "concurrencyController.h"
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <atomic>
+#include <curl/curl.h>
 
 #include <memory>
 
 const static std::string NEXTCLOUD_ROOT_PATH = "/remote.php/dav/files/";
 const std::string NEXTCLOUD_START_PATH = "/remote.php/";
 const std::string NEXTCLOUD_PATH = "/mnt/ext1/system/config/nextcloud";
+const std::string NEXTCLOUD_DAV_PATH = "/remote.php/dav";
+const std::string NEXTCLOUD_UPLOADS_PATH = "/remote.php/dav/uploads/";
+//items of a tree request that are handed over at once while the response is received
+const size_t TREE_BATCH = 500;
+//highest number of parallel downloads if "parallelDownloads" is not set, the controller starts with DOWNLOAD_START_PARALLEL
+const int DOWNLOAD_MAX_PARALLEL = 6;
+const int DOWNLOAD_START_PARALLEL = 2;
+//files above this size are uploaded in chunks of this size, Nextcloud requires at least 5 MB per chunk except the last
+const long UPLOAD_CHUNK_SIZE = 10 * 1024 * 1024;
+//number of chunks that are uploaded at once if "parallelUploads" is not set
+const int UPLOAD_PARALLEL = 3;
+
+/**
+ * Properties that are requested by a PROPFIND, each call site only asks for what it uses
+ */
+enum class PropfindProfile
+{
+    //members of a folder with everything needed to show and sync them
+    ILISTING,
+    //only the etag of the resource itself to check if anything below it has changed
+    IETAG,
+    //members of an upload folder with their size to resume a chunked upload
+    ICHUNKS
+};
+
+/**
+ * Headers of a response that are evaluated
+ */
+struct ResponseHeaders
+{
+    //delay the server asked for in ms, -1 if it did not send Retry-After
+    long retryAfter = -1;
+    //etag of the uploaded file, OC-ETag is preferred as proxies can change the ETag
+    std::string etag;
+};
+
+enum class SyncResult
+{
+    ISUCCESS,
+    IUNSUPPORTED,
+    IINVALIDTOKEN,
+    IFAILED
+};
 
 class WebDAV
 {
@@ -32,12 +81,30 @@ class WebDAV
         WebDAV();
         ~WebDAV();
 
+        //owns the curl handles, therefore it must not be copied
+        WebDAV(const WebDAV &) = delete;
+        WebDAV &operator=(const WebDAV &) = delete;
+
         std::vector<WebDAVItem> login(const std::string &Url, const std::string &Username, const std::string &Pass, bool ignoreCert = false);
 
         void logout(bool deleteFiles = false);
 
         std::vector<WebDAVItem> getDataStructure(const std::string &pathUrl);
 
+        /**
+         * Returns the path on the server of a file or folder in the storage location
+         * The path is encoded the same way as the paths in the responses of the server
+         *
+         * @param localPath path of the item in the storage location
+         * @param folder true if the item is a folder, it ends with a slash then
+         */
+        static std::string getRemotePath(const std::string &localPath, bool folder);
+
+        /**
+         * Formats a size in bytes as it is shown in the listing
+         */
+        static std::string formatSize(double size);
+
         /**
          * Returns the root path of the nextcloud server 
          * (e.g. /remote.php/dav/files/userName/startFolder/)
@@ -45,23 +112,343 @@ class WebDAV
         static std::string getRootPath(bool encode = false);
 
     /**
-        * gets the dataStructure of the given URL and writes its WEBDAV items to the items vector
+        * gets the dataStructure of the given URL and streams the response into the parser
         *
         * @param pathUrl URL to get the dataStructure of
-        * @param Username the username of the Nextcloud instance
-        * @param Pass the pass of the Nextcloud instance
-        * @return vector of Items
+        * @param parser parser that receives the multistatus response while it is downloaded
+        * @param profile properties that are requested, the etag profile only requests the resource itself
+        * @return true if the server answered with a multistatus
         */
-        std::string propfind(const std::string &pathUrl);
+        bool propfind(const std::string &pathUrl, PropfindParser &parser, PropfindProfile profile = PropfindProfile::ILISTING);
+
+        /**
+         * Requests only the etag of a folder, it changes if anything below the folder has changed
+         *
+         * @param pathUrl folder that is checked
+         * @return etag or an empty string if the request failed
+         */
+        std::string getEtag(const std::string &pathUrl);
+
+        /**
+         * Requests the changes below the given path since the sync-token via the sync-collection report (RFC 6578)
+         *
+         * @param pathUrl collection the changes are requested for
+         * @param syncToken token of the last sync, empty to request all members
+         * @param changed items that have been created or changed
+         * @param removed paths of the items that have been removed
+         * @param newSyncToken token that has to be send with the next request
+         * @return ISUCCESS if the changes could be received, otherwise the etag walk has to be used
+         */
+        SyncResult getChanges(const std::string &pathUrl, const std::string &syncToken, std::vector<WebDAVItem> &changed, std::vector<std::string> &removed, std::string &newSyncToken);
+
+        /**
+         * Requests all items below the folder with one PROPFIND using Depth: infinity
+         *
+         * @param pathUrl folder the items are requested for
+         * @param onItems receives the items in batches while the response is parsed
+         * @return IUNSUPPORTED if the server does not allow Depth: infinity
+         */
+        SyncResult getTree(const std::string &pathUrl, const std::function<void(std::vector<WebDAVItem> &)> &onItems);
+
+        /**
+         * Requests all items below the folder with one Nextcloud SEARCH (RFC 5323) scoped to the folder
+         *
+         * @param pathUrl folder the items are requested for
+         * @param onItems receives the items in batches while the response is parsed
+         * @return IUNSUPPORTED if the server does not support SEARCH
+         */
+        SyncResult searchTree(const std::string &pathUrl, const std::function<void(std::vector<WebDAVItem> &)> &onItems);
 
         bool get(WebDAVItem &item);
 
+        /**
+         * Creates the folders on the server, the requests reuse one connection
+         *
+         * @param paths remote paths of the folders, parents have to be in front of their children
+         * @return false if a folder could not be created, existing folders are no error
+         */
+        bool createFolders(const std::vector<std::string> &paths);
+
+        /**
+         * Uploads a local file, files larger than UPLOAD_CHUNK_SIZE are send with the chunked upload of Nextcloud (v2)
+         * The chunks are sent in parallel and an interrupted upload continues with the missing chunks the next time
+         * A file that exists on the server already is never overwritten
+         *
+         * @param item file with localPath and path set, the etag is set to the one of the uploaded version
+         * @return true if the file has been uploaded
+         */
+        bool put(WebDAVItem &item);
+
+        /**
+         * Downloads several files at once using curl multi
+         * The number of parallel transfers follows the measured throughput, the config entry "parallelDownloads" sets the upper limit
+         *
+         * @param items files that shall be downloaded
+         * @param onFinished called for each item that has been downloaded successfully
+         * @return number of files that could not be downloaded
+         */
+        int getMultiple(std::vector<WebDAVItem> &items, const std::function<void(WebDAVItem &)> &onFinished);
+
+        /**
+         * Redirects the messages and the progress of the requests instead of showing them on the screen
+         * This is needed if the requests are sent outside of the UI thread, dialogs are not shown then
+         *
+         * @param onMessage receives icon, title, text and timeout of a message
+         * @param onProgress receives text and percentage of the progress
+         */
+        void setHandlers(std::function<void(int, const std::string &, const std::string &, int)> onMessage, std::function<void(const std::string &, int)> onProgress);
+
+        /**
+         * Sets a flag that aborts the running requests once it is set, they stop before the next chunk is received
+         */
+        void setCancelFlag(const std::atomic<bool> *cancel) { _cancel = cancel; };
+
+        /**
+         * Returns the number of connections that had to be opened to the server
+         */
+        long getOpenedConnections() const { return _openedConnections; };
+
+        /**
+         * Returns the number of requests that reused an already open connection
+         */
+        long getReusedConnections() const { return _reusedConnections; };
+
+        /**
+         * Returns the requests that failed since the last call, with handlers they are collected instead of shown one by one
+         */
+        ErrorReport takeReport();
+
     private:
         std::string _username;
         std::string _password;
         std::string _url;
         bool _ignoreCert;
 
+        CURL *_curl = nullptr;
+        CURLSH *_curlShare = nullptr;
+        CURLM *_curlMulti = nullptr;
+        std::vector<CURL *> _transferHandles;
+        long _openedConnections = 0;
+        long _reusedConnections = 0;
+        bool _syncCollectionSupported = true;
+        bool _depthInfinitySupported = true;
+        bool _searchSupported = true;
+        std::function<void(int, const std::string &, const std::string &, int)> _onMessage;
+        std::function<void(const std::string &, int)> _onProgress;
+        const std::atomic<bool> *_cancel = nullptr;
+        std::string _progressText;
+        int _lastPercentage = -1;
+        RetryPolicy _retry;
+        ResponseHeaders _responseHeaders;
+        ErrorReport _report;
+        //kept between the batches, so that the next one starts with the level found before
+        ConcurrencyController _downloadConcurrency = ConcurrencyController(DOWNLOAD_START_PARALLEL, DOWNLOAD_MAX_PARALLEL);
+
+        struct DownloadTransfer
+        {
+            WebDAVItem *item = nullptr;
+            CURL *curl = nullptr;
+            FILE *fp = nullptr;
+            std::string partPath;
+            curl_off_t resumeFrom = 0;
+            curl_off_t dlnow = 0;
+            curl_off_t dltotal = 0;
+            long responseCode = 0;
+            ResponseHeaders responseHeaders;
+            struct curl_slist *headers = nullptr;
+            const std::atomic<bool> *cancel = nullptr;
+        };
+
+        struct UploadChunk
+        {
+            std::string url;
+            //part of the local file that is sent
+            curl_off_t offset = 0;
+            curl_off_t length = 0;
+            curl_off_t sent = 0;
+            curl_off_t ulnow = 0;
+            FILE *fp = nullptr;
+            CURL *curl = nullptr;
+            struct curl_slist *headers = nullptr;
+            ResponseHeaders responseHeaders;
+            int attempts = 0;
+            const std::atomic<bool> *cancel = nullptr;
+        };
+
+        void showMessage(int icon, const std::string &title, const std::string &text, int timeout);
+
+        void showProgress(const std::string &text, int percent);
+
+        /**
+         * Logs a failed request and adds it to the report, without handlers it is shown directly
+         *
+         * @param error class of the error
+         * @param request method and path of the request
+         * @param text message for the user
+         */
+        void reportError(RequestError error, const std::string &request, const std::string &text);
+
+        /**
+         * Performs the prepared request and repeats it after a backoff while the error is transient
+         *
+         * @param curl prepared handle
+         * @param request method and path of the request for the log
+         * @param parser parser that receives the response, it is reset before each retry, nullptr if the response is not needed
+         * @param res is set to the result of curl
+         * @param responseCode is set to the response code of the server
+         * @return class of the error of the last attempt
+         */
+        RequestError performRequest(CURL *curl, const std::string &request, PropfindParser *parser, CURLcode &res, long &responseCode);
+
+        /**
+         * Sends a request without body whose response body is not needed, e.g. MKCOL and MOVE
+         *
+         * @param method method of the request
+         * @param pathUrl path the request is sent to
+         * @param headers additional headers
+         * @param responseCode is set to the response code of the server
+         * @return class of the error of the last attempt
+         */
+        RequestError sendRequest(const std::string &method, const std::string &pathUrl, const std::vector<std::string> &headers, long &responseCode);
+
+        /**
+         * Creates the curl multi handle and the handles for the parallel transfers
+         *
+         * @param parallel transfers that shall run at once
+         * @return number of handles that can be used
+         */
+        size_t prepareTransferHandles(size_t parallel);
+
+        /**
+         * Uploads a file in chunks to an upload folder and moves it to its target once all chunks are there
+         *
+         * @param item file that is uploaded
+         * @param size size of the local file
+         * @param mtime modification time of the local file, it is kept on the server
+         */
+        bool putChunked(WebDAVItem &item, curl_off_t size, time_t mtime);
+
+        /**
+         * Sends parts of a file in parallel, parts that fail with a transient error are sent again after a backoff
+         *
+         * @param localPath file the parts are read from
+         * @param chunks parts that shall be sent, the response headers are set for each of them
+         * @param headers headers every request is sent with
+         * @param total size of all parts for the progress
+         * @return false if a part could not be sent
+         */
+        bool sendChunks(const std::string &localPath, std::vector<UploadChunk> &chunks, const std::vector<std::string> &headers, curl_off_t total);
+
+        /**
+         * Reads the next part of a chunk from the local file
+         */
+        static size_t readChunk(char *buffer, size_t size, size_t nitems, void *userp);
+
+        /**
+         * Stores the progress of an upload
+         */
+        static int chunkProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+        /**
+         * Reads the Retry-After and the etag headers of a response
+         *
+         * @param userdata pointer to the ResponseHeaders
+         */
+        static size_t readHeader(char *buffer, size_t size, size_t nitems, void *userdata);
+
+        bool isCancelled() const { return _cancel && _cancel->load(); };
+
+        /**
+         * Connects to the network, with handlers the UI thread has to do this before
+         */
+        bool connectToNetwork();
+
+        /**
+         * Aborts the request if the cancel flag is set and reports the progress to the handler
+         *
+         * @param clientp pointer to the WebDAV object
+         */
+        static int requestProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+        /**
+         * Prepares the handle to download the item into a .part file next to the target
+         * A part file of an earlier attempt is resumed via Range and the etag of the local copy is send via If-None-Match
+         *
+         * @param transfer transfer with item and curl handle set
+         * @return false if the part file could not be opened
+         */
+        bool startTransfer(DownloadTransfer &transfer);
+
+        /**
+         * Closes the part file and renames it to the target if the download succeeded
+         *
+         * @param transfer transfer that has been performed
+         * @param res result of curl
+         * @param responseCode is set to the response code of the server
+         * @return true if the file is downloaded or the local copy is up to date
+         */
+        bool finishTransfer(DownloadTransfer &transfer, CURLcode res, long &responseCode);
+
+        /**
+         * Writes the body of successful responses into the part file
+         */
+        static size_t writeTransfer(void *ptr, size_t size, size_t nmemb, void *userp);
+
+        /**
+         * Stores the progress of a transfer
+         */
+        static int transferProgress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+        /**
+         * Resets the long-lived curl handle and sets the options every request needs
+         * The connection, DNS and TLS session caches survive the reset
+         *
+         * @param url url the request is sent to
+         * @return curl handle or nullptr if it could not be created
+         */
+        CURL *prepareCurl(const std::string &url);
+
+        /**
+         * Converts a parsed response of the server into an item
+         *
+         * @param response response of the server
+         * @param storageLocation local folder the files are stored in
+         * @param prefix root path of the user that is stripped for the hide state
+         */
+        WebDAVItem createItem(const PropfindResponse &response, const std::string &storageLocation, const std::string &prefix);
+
+        /**
+         * Sets the url, credentials and connection options on an curl handle
+         */
+        void setCommonOptions(CURL *curl, const std::string &url);
+
+        /**
+         * Counts if the last request on the handle opened a new connection or reused one
+         */
+        void trackConnections(CURL *curl);
+
+        /**
+         * Sends a request whose multistatus response contains a whole tree and hands the items over in batches
+         *
+         * @param method PROPFIND or SEARCH
+         * @param url complete url of the request
+         * @param depth value of the Depth header, empty to send none
+         * @param body body of the request
+         * @param pathUrl folder the items are requested for
+         * @param onItems receives the items in batches
+         * @return IUNSUPPORTED if the server rejected the request
+         */
+        SyncResult requestTree(const std::string &method, const std::string &url, const std::string &depth, const std::string &body, const std::string &pathUrl, const std::function<void(std::vector<WebDAVItem> &)> &onItems);
+
+        /**
+         * Logs the bytes of a request on the wire and after decoding
+         *
+         * @param curl handle of the finished request
+         * @param request name of the request for the log
+         * @param parser parser that received the decoded response
+         */
+        void logResponseSize(CURL *curl, const std::string &request, const PropfindParser &parser);
+
         std::shared_ptr<FileHandler> _fileHandler;
 
 };
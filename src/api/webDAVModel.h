@@ -37,6 +37,8 @@ enum HideState
 
 struct WebDAVItem : Entry{
     std::string etag;
+    //etag of the version that is saved locally
+    std::string localEtag;
     std::string path;
     std::string title;
     std::string localPath;
@@ -46,6 +48,8 @@ struct WebDAVItem : Entry{
     std::string size;
     std::string fileType;
     HideState hide;
+    //version of the exclusion rules the hide state was evaluated with
+    unsigned int hideVersion = 0;
 };
 
 #endif
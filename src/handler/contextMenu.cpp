@@ -22,6 +22,7 @@ ContextMenu::~ContextMenu()
     free(_menu);
     free(_open);
     free(_sync);
+    free(_upload);
     free(_remove);
 }
 
@@ -31,7 +32,8 @@ int ContextMenu::createMenu(int y, FileState itemstate, iv_menuhandler handler)
         {
             {ITEM_HEADER, 0, _menu, NULL},
             {(itemstate != FileState::ICLOUD) ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 101, _open, NULL},
-            {ITEM_ACTIVE, 102, _sync, NULL},
+            //local items are uploaded instead
+            {ITEM_ACTIVE, 102, (itemstate == FileState::ILOCAL) ? _upload : _sync, NULL},
             {(itemstate != FileState::ICLOUD) ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 103, _remove, NULL},
             {0, 0, NULL, NULL}};
 
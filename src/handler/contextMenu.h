@@ -35,6 +35,7 @@ private:
     char *_menu = strdup("Menu");
     char *_open = strdup("Open");
     char *_sync = strdup("Sync");
+    char *_upload = strdup("Upload");
     char *_remove = strdup("Remove local");
 };
 #endif
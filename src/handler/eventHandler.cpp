@@ -24,6 +24,7 @@
 #include <string>
 #include <memory>
 #include <algorithm>
+#include <chrono>
 
 using std::string;
 using std::vector;
@@ -39,6 +40,14 @@ EventHandler::EventHandler()
 
     _fileHandler = std::shared_ptr<FileHandler>(new FileHandler());
     _menu = std::unique_ptr<MainMenu>(new MainMenu("Nextcloud"));
+    Util::addConfigListener([this](const string &name) {
+        if (name == "storageLocation" || name == "username")
+        {
+            _sqllite->setLocalStatesTracked(false);
+            _worker->setLocalStatesTracked(false);
+            _localRescan = true;
+        }
+    });
     if (iv_access(CONFIG_PATH.c_str(), W_OK) == 0)
     {
         //for backwards compatibilty
@@ -48,44 +57,24 @@ EventHandler::EventHandler()
         if (iv_access(Util::getConfig<string>("storageLocation").c_str(), W_OK) != 0)
             iv_mkdir(Util::getConfig<string>("storageLocation").c_str(), 0777);
 
-        std::vector<WebDAVItem> currentWebDAVItems;
-        string path = WebDAV::getRootPath(true);
-
-        currentWebDAVItems = _webDAV.getDataStructure(path);
         _menu = std::unique_ptr<MainMenu>(new MainMenu("Nextcloud"));
-
-        if (currentWebDAVItems.empty())
-            currentWebDAVItems = _sqllite.getItemsChildren(path);
-        else
-            updateItems(currentWebDAVItems);
-
-        if (currentWebDAVItems.empty())
-        {
-            int dialogResult = DialogSynchro(ICON_QUESTION, "Action", "Could not login and there is no DB available to restore information. What would you like to do?", "Logout", "Close App", NULL);
-            switch (dialogResult)
-            {
-                case 1:
-                    {
-                        _webDAV.logout(true);
-                        _loginView = std::unique_ptr<LoginView>(new LoginView(_menu->getContentRect()));
-                    }
-                    break;
-                case 2:
-                default:
-                    CloseApp();
-                    break;
-            }
-        }
+        string path = WebDAV::getRootPath(true);
+        //the last known listing is shown at once and refreshed in the background
+        if (drawStoredItems(path))
+            pushJob(SyncJob{SyncJobType::ILISTFOLDER, path, WebDAVItem()});
         else
-        {
-            drawWebDAVItems(currentWebDAVItems);
-        }
+            requestFolder(path);
+        resumeTransfers();
+        //items of changed exclusion rules that could not be evaluated in the last session
+        SetWeakTimer("HideStates", hideStatesTimerStatic, HIDESTATES_INTERVAL);
     }
     else
     {
         _menu = std::unique_ptr<MainMenu>(new MainMenu("Nextcloud"));
         _loginView = std::unique_ptr<LoginView>(new LoginView(_menu->getContentRect()));
     }
+    //the first call scans the storage location as changes while the app was closed are unknown
+    SetWeakTimer("LocalChanges", localChangesTimerStatic, LOCALCHANGES_INTERVAL);
 }
 
 int EventHandler::eventDistributor(const int type, const int par1, const int par2)
@@ -94,10 +83,99 @@ int EventHandler::eventDistributor(const int type, const int par1, const int par
         return EventHandler::pointerHandler(type, par1, par2);
     else if (ISKEYEVENT(type))
         return EventHandler::keyHandler(type, par1, par2);
+    else if (type == SYNCWORKER_EVENT)
+    {
+        handleWorkerEvent();
+        return 0;
+    }
+    else if (type == EVT_NET_CONNECTED)
+    {
+        //downloads that failed as the connection was lost are continued
+        if (_loginView == nullptr && !_worker->isBusy())
+            resumeTransfers();
+        return 0;
+    }
 
     return 1;
 }
 
+void EventHandler::hideStatesTimerStatic()
+{
+    if (_eventHandlerStatic)
+        _eventHandlerStatic->updateHideStates();
+}
+
+void EventHandler::updateHideStates()
+{
+    if (_sqllite->updateOutdatedHideStates(HIDESTATES_BATCH) == HIDESTATES_BATCH)
+        SetWeakTimer("HideStates", hideStatesTimerStatic, HIDESTATES_INTERVAL);
+}
+
+void EventHandler::localChangesTimerStatic()
+{
+    if (_eventHandlerStatic)
+        _eventHandlerStatic->recordLocalChanges();
+}
+
+void EventHandler::recordLocalChanges()
+{
+    if (_localScanPending)
+    {
+        //the scan is removed from the queue if the user cancels the running job
+        if (!_worker->isBusy())
+        {
+            _localScanPending = false;
+            _localRescan = true;
+        }
+    }
+    else if (_localRescan)
+    {
+        rescanLocalFiles();
+    }
+    else
+    {
+        pollLocalChanges();
+    }
+    SetWeakTimer("LocalChanges", localChangesTimerStatic, LOCALCHANGES_INTERVAL);
+}
+
+void EventHandler::rescanLocalFiles()
+{
+    _localRescan = false;
+    _localWatcher->stop();
+    _sqllite->setLocalStatesTracked(false);
+    _worker->setLocalStatesTracked(false);
+    if (_fileHandler->getStorageUsername().empty())
+        return;
+
+    //walking a large storage location takes too long for the UI thread, the watcher is handed back with the result
+    _localScanPending = true;
+    _worker->push(SyncJob{SyncJobType::ILOCALSCAN, Util::getConfig<string>("storageLocation") + "/" + _fileHandler->getStorageUsername(), WebDAVItem()});
+}
+
+void EventHandler::pollLocalChanges()
+{
+    vector<LocalChange> changes;
+    if (!_localWatcher->poll(changes))
+    {
+        //events have been lost, the files are checked directly until the next scan
+        Log::writeInfoLog("Local changes have been lost, scanning the storage location again");
+        _sqllite->setLocalStatesTracked(false);
+        _localRescan = true;
+    }
+    if (!changes.empty())
+        _sqllite->addLocalChanges(changes);
+}
+
+void EventHandler::applyLocalChanges()
+{
+    if (!_localWatcher->isComplete())
+        return;
+    pollLocalChanges();
+    if (_localWatcher->isComplete())
+        _sqllite->applyLocalChanges();
+}
+
 void EventHandler::mainMenuHandlerStatic(const int index)
 {
     _eventHandlerStatic->mainMenuHandler(index);
@@ -110,62 +188,7 @@ void EventHandler::mainMenuHandler(const int index)
         //Actualize the current folder
         case 101:
             {
-                OpenProgressbar(1, "Actualizing current folder", ("Actualizing path" + _currentPath).c_str(), 0, NULL);
-                string childrenPath = _currentPath;
-                childrenPath = childrenPath.substr(NEXTCLOUD_ROOT_PATH.length(), childrenPath.length());
-                std::string path = NEXTCLOUD_ROOT_PATH;
-                std::vector<WebDAVItem> currentWebDAVItems;
-                size_t found = 0;
-                int i = 0;
-                while((found = childrenPath.find("/"),found) != std::string::npos)
-                {
-                    path += childrenPath.substr(0, found+1);
-                    childrenPath = childrenPath.substr(found+1,childrenPath.length());
-                    auto state = _sqllite.getState(path);
-                    Log::writeInfoLog("cur path " + path);
-                    if (i < 1 || state == FileState::IOUTSYNCED || state == FileState::ICLOUD)
-                    {
-                        UpdateProgressbar(("Upgrading " + path).c_str(), 0);
-                        currentWebDAVItems = _webDAV.getDataStructure(path);
-                    }
-                    else
-                    {
-                        break;
-                    }
-
-                    if (currentWebDAVItems.empty())
-                    {
-                        Log::writeErrorLog("Could not sync " + path + " via actualize.");
-                        Message(ICON_WARNING, "Warning", "Could not sync the file structure.", 2000);
-                        HideHourglass();
-                        break;
-                    }
-                    else
-                    {
-                        updateItems(currentWebDAVItems);
-                    }
-                    i++;
-                }
-
-                Log::writeInfoLog("stopped at " + path );
-                currentWebDAVItems = _sqllite.getItemsChildren(_currentPath);
-
-                for(auto &item : currentWebDAVItems)
-                {
-                    Log::writeInfoLog(item.path);
-                    if (item.type == Itemtype::IFOLDER && item.state == FileState::IOUTSYNCED)
-                    {
-                        UpdateProgressbar(("Upgrading " + item.path).c_str(), 0);
-                        vector<WebDAVItem> tempWebDAVItems = _webDAV.getDataStructure(item.path);
-                        updateItems(tempWebDAVItems);
-                    }
-
-                }
-                currentWebDAVItems = _sqllite.getItemsChildren(_currentPath);
-
-                CloseProgressbar();
-                if (!currentWebDAVItems.empty())
-                    drawWebDAVItems(currentWebDAVItems);
+                pushJob(SyncJob{SyncJobType::IRECONCILE, _currentPath, WebDAVItem()});
                 break;
             }
             //Logout
@@ -174,15 +197,13 @@ void EventHandler::mainMenuHandler(const int index)
                 int dialogResult = DialogSynchro(ICON_QUESTION, "Action", "Do you want to delete local files?", "Yes", "No", "Cancel");
                 switch (dialogResult)
                 {
-                    case 1:
-                        _webDAV.logout(true);
-                        break;
                     case 3:
                         return;
                     default:
-                        _webDAV.logout();
                         break;
                 }
+                _pendingPath.clear();
+                logout(dialogResult == 1);
                 _webDAVView.reset();
                 _loginView = std::unique_ptr<LoginView>(new LoginView(_menu->getContentRect()));
                 break;
@@ -215,6 +236,7 @@ void EventHandler::mainMenuHandler(const int index)
                     _currentPath = "";
                 }
 
+                _pendingPath.clear();
                 _webDAVView.reset();
                 FillAreaRect(&_menu->getContentRect(), WHITE);
                 _excludeFileView = std::unique_ptr<ExcludeFileView>(new ExcludeFileView(_menu->getContentRect()));
@@ -234,17 +256,8 @@ void EventHandler::mainMenuHandler(const int index)
                 else
                 {
                     Util::writeConfig<string>("storageLocation", _currentPath);
-                    std::vector<WebDAVItem> currentWebDAVItems = _webDAV.getDataStructure(WebDAV::getRootPath(true));
-                    if (currentWebDAVItems.empty())
-                    {
-                        Message(ICON_ERROR, "Error", "Failed to get items. Please try again.", 1000);
-                    }
-                    else
-                    {
-                        _fileView.reset();
-                        updateItems(currentWebDAVItems);
-                        drawWebDAVItems(currentWebDAVItems);
-                    }
+                    //the file picker is shown until the items have been received
+                    requestFolder(WebDAV::getRootPath(true));
                 }
                 break;
             }
@@ -259,6 +272,12 @@ void EventHandler::mainMenuHandler(const int index)
         case 107:
             CloseApp();
             break;
+            //Cancel sync
+        case 108:
+            _worker->cancel();
+            //the queued downloads are not continued on the next start either
+            _sqllite->clearTransfers();
+            break;
         default:
             break;
     }
@@ -296,9 +315,9 @@ void EventHandler::contextMenuHandler(const int index)
         }
         else
         {
-            //TODO upload to cloud
-            //Dialog file is offline, do you want to sync it to the cloud?
-            Message(ICON_ERROR, "Error", "The File is local and upload to cloud is currently not supported.", 2000);
+            Log::writeInfoLog("Queued upload of " + _webDAVView->getCurrentEntry().localPath);
+            pushJob(SyncJob{SyncJobType::IUPLOAD, _currentPath, _webDAVView->getCurrentEntry()});
+            //the entry is redrawn once the upload has finished
             _webDAVView->invertCurrentEntryColor();
         }
 
@@ -317,9 +336,9 @@ void EventHandler::contextMenuHandler(const int index)
             {
                 fs::remove(_webDAVView->getCurrentEntry().localPath);
             }
-            vector<WebDAVItem> currentWebDAVItems = _sqllite.getItemsChildren(_currentPath);
-            updateItems(currentWebDAVItems);
-            drawWebDAVItems(currentWebDAVItems);
+            //the watcher has recorded the removal, the stored states show it once it is applied
+            applyLocalChanges();
+            drawStoredItems(_currentPath, _webDAVView->getShownPage());
         }
         else
         {
@@ -355,7 +374,7 @@ int EventHandler::pointerHandler(const int type, const int par1, const int par2)
     {
         if (IsInRect(par1, par2, &_menu->getMenuButtonRect()) == 1)
         {
-            return _menu->createMenu((_fileView != nullptr), (_webDAVView != nullptr), EventHandler::mainMenuHandlerStatic);
+            return _menu->createMenu((_fileView != nullptr), (_webDAVView != nullptr), _worker->isBusy(), EventHandler::mainMenuHandlerStatic);
         }
         else if (_webDAVView != nullptr)
         {
@@ -391,11 +410,12 @@ int EventHandler::pointerHandler(const int type, const int par1, const int par2)
                 Util::writeConfig<string>("ex_relativeRootPath", _excludeFileView->getStartFolder());
                 Util::writeConfig<int>("ex_invertMatch", _excludeFileView->getInvertMatch());
                 
-                _sqllite.resetHideState();
                 if (_excludeFileView->getStartFolder() != "") 
                 {
-                    _sqllite.deleteItemsNotBeginsWith(WebDAV::getRootPath(true));
+                    _sqllite->deleteItemsNotBeginsWith(WebDAV::getRootPath(true));
                 }
+                //the opened folders are evaluated when they are loaded, the others in batches while the device is idle
+                SetWeakTimer("HideStates", hideStatesTimerStatic, HIDESTATES_INTERVAL);
 
                 _excludeFileView.reset();
                 ShowHourglassForce();
@@ -405,9 +425,7 @@ int EventHandler::pointerHandler(const int type, const int par1, const int par2)
                     vector<FileItem> currentFolder = FileBrowser::getFileStructure(_currentPath,false,true);
                     _fileView.reset(new FileView(_menu->getContentRect(), currentFolder,1));
                 } else {
-                    std::vector<WebDAVItem> currentWebDAVItems = _webDAV.getDataStructure(WebDAV::getRootPath(true));
-                    updateItems(currentWebDAVItems);
-                    drawWebDAVItems(currentWebDAVItems);
+                    requestFolder(WebDAV::getRootPath(true));
                 }
             }
             else if (click == -1) {
@@ -419,9 +437,7 @@ int EventHandler::pointerHandler(const int type, const int par1, const int par2)
                     vector<FileItem> currentFolder = FileBrowser::getFileStructure(_currentPath,false,true);
                     _fileView.reset(new FileView(_menu->getContentRect(), currentFolder,1));
                 } else {
-                    std::vector<WebDAVItem> currentWebDAVItems = _webDAV.getDataStructure(WebDAV::getRootPath(true));
-                    updateItems(currentWebDAVItems);
-                    drawWebDAVItems(currentWebDAVItems);
+                    requestFolder(WebDAV::getRootPath(true));
                 }
             }
         }
@@ -457,8 +473,8 @@ int EventHandler::pointerHandler(const int type, const int par1, const int par2)
                         default:
                             if (iv_access(Util::getConfig<string>("storageLocation").c_str(), W_OK) != 0)
                                 iv_mkdir(Util::getConfig<string>("storageLocation").c_str(), 0777);
-                            updateItems(currentWebDAVItems);
-                            drawWebDAVItems(currentWebDAVItems);
+                            //the worker compares the items with the DB and stores them before they are shown
+                            requestFolder(WebDAV::getRootPath(true));
                             break;
                     }
                 }
@@ -515,9 +531,7 @@ void EventHandler::openItem()
 
 void EventHandler::openFolder()
 {
-    std::vector<WebDAVItem> currentWebDAVItems;
-
-    switch ((_webDAVView->getCurrentEntry().state == FileState::ILOCAL) ? FileState::ILOCAL : _sqllite.getState(_webDAVView->getCurrentEntry().path))
+    switch ((_webDAVView->getCurrentEntry().state == FileState::ILOCAL) ? FileState::ILOCAL : _sqllite->getState(_webDAVView->getCurrentEntry().path))
     {
         case FileState::ILOCAL:
             {
@@ -531,25 +545,16 @@ void EventHandler::openFolder()
             }
         case FileState::IOUTSYNCED:
         case FileState::ICLOUD:
-            ShowHourglassForce();
-            currentWebDAVItems = _webDAV.getDataStructure(_webDAVView->getCurrentEntry().path);
+            requestFolder(_webDAVView->getCurrentEntry().path);
+            break;
         case FileState::ISYNCED:
         case FileState::IDOWNLOADED:
             {
-                if (currentWebDAVItems.empty() && _webDAVView->getCurrentEntry().state != FileState::ICLOUD)
-                    currentWebDAVItems = _sqllite.getItemsChildren(_webDAVView->getCurrentEntry().path);
-                updateItems(currentWebDAVItems);
-
-                if (currentWebDAVItems.empty())
+                if (!drawStoredItems(_webDAVView->getCurrentEntry().path))
                 {
                     Message(ICON_ERROR, "Error", "Could not sync the items and there is no offline copy available.", 2000);
-                    HideHourglass();
                     _webDAVView->invertCurrentEntryColor();
                 }
-                else
-                {
-                    drawWebDAVItems(currentWebDAVItems);
-                }
                 break;
             }
     }
@@ -609,267 +614,221 @@ int EventHandler::keyHandler(const int type, const int par1, const int par2)
     return 1;
 }
 
-void EventHandler::getLocalFileStructure(std::vector<WebDAVItem> &tempItems)
+void EventHandler::startDownload()
+{
+    Log::writeInfoLog("Queued download of " + _webDAVView->getCurrentEntry().path + " to " + _webDAVView->getCurrentEntry().localPath);
+    //a running download takes the tapped file with its next batch
+    if (_webDAVView->getCurrentEntry().type == Itemtype::IFILE)
+        _sqllite->addTransfers({_webDAVView->getCurrentEntry()}, TransferPriority::ITAPPED, "");
+    pushJob(SyncJob{SyncJobType::IDOWNLOAD, _webDAVView->getCurrentEntry().path, _webDAVView->getCurrentEntry()});
+    //the entry is redrawn once the download has finished
+    _webDAVView->invertCurrentEntryColor();
+}
+
+void EventHandler::pushJob(const SyncJob &job)
 {
-    string localPath = tempItems.at(0).localPath + '/';
-    if (iv_access(localPath.c_str(), W_OK) == 0)
+    //the worker trusts the stored states only if all local changes are part of them
+    applyLocalChanges();
+    _worker->setLocalStatesTracked(_localWatcher->isComplete());
+    if (!Util::connectToNetwork())
     {
-        vector<FileItem> currentFolder = FileBrowser::getFileStructure(localPath,true,false);
+        SyncJobResult result;
+        result.job = job;
+        handleJobResult(result);
+        return;
+    }
+    _worker->push(job);
+}
 
-        const int storageLocationLength = _fileHandler->getStorageLocation().length();
-        for(const FileItem &local : currentFolder)
-        {
-            auto p = find_if(tempItems.begin()+1, tempItems.end(), [&] (const WebDAVItem &item) {return item.localPath.compare(local.path) == 0;});
-            if (p == tempItems.end())
-            {
-                WebDAVItem temp;
-                temp.localPath = local.path;
-                temp.state = FileState::ILOCAL;
-                temp.title = temp.localPath.substr(temp.localPath.find_last_of('/') + 1, temp.localPath.length());
-                //Log::writeInfoLog(std::to_string(fs::file_size(entry)));
-                temp.lastEditDate = local.lastEditDate;
-
-                string directoryPath = temp.localPath;
-                if (directoryPath.length() > storageLocationLength) {
-                    directoryPath = directoryPath.substr(storageLocationLength + 1);
-                }
-                if(local.type == Type::FFOLDER)
-                {
-                    if (_fileHandler->excludeFolder(directoryPath + "/")) {
-                        continue;
-                    }
-                    //create new dir in cloud
-                    temp.type = Itemtype::IFOLDER;
-                }
-                else
-                {
-                    //put to cloud
-                    temp.type = Itemtype::IFILE;
-                    if (directoryPath.length() > temp.title.length()) {
-                        directoryPath = directoryPath.substr(0, directoryPath.length() - temp.title.length());
-                    }
-                    if (_fileHandler->excludeFolder(directoryPath) || _fileHandler->excludeFile(temp.title))
-                    {
-                        continue;
-                    }
-                }
-                tempItems.push_back(temp);
-            }
+void EventHandler::requestFolder(const string &path)
+{
+    _pendingPath = path;
+    pushJob(SyncJob{SyncJobType::ILISTFOLDER, path, WebDAVItem()});
+}
 
-        }
+void EventHandler::resumeTransfers()
+{
+    int queued = _sqllite->countTransfers();
+    if (queued == 0)
+        return;
+    Log::writeInfoLog("Resuming " + std::to_string(queued) + " queued downloads");
+    pushJob(SyncJob{SyncJobType::ITRANSFERS, "", WebDAVItem()});
+}
+
+void EventHandler::logout(bool deleteFiles)
+{
+    //the running jobs must not write into the DB of the logged out user and no connection may keep the deleted file open
+    _worker.reset();
+    _sqllite.reset();
+    _localWatcher->stop();
+    _localScanPending = false;
+    _webDAV.logout(deleteFiles);
+    _sqllite = std::unique_ptr<SqliteConnector>(new SqliteConnector(DB_PATH));
+    _worker = std::unique_ptr<SyncWorker>(new SyncWorker(DB_PATH));
+    _localRescan = true;
+}
+
+void EventHandler::handleWorkerEvent()
+{
+    SyncUpdate update = _worker->takeUpdate();
+
+    for (const auto &message : update.messages)
+        Message(message.icon, message.title.c_str(), message.text.c_str(), message.timeout);
+
+    for (auto &result : update.results)
+        handleJobResult(result);
+
+    string status;
+    if (update.busy)
+    {
+        status = update.status;
+        if (update.percent > 0)
+            status += " " + std::to_string(update.percent) + "%";
     }
+    _menu->setStatus(status);
 }
 
-void EventHandler::downloadFolder(vector<WebDAVItem> &items, int itemID)
+void EventHandler::handleJobResult(SyncJobResult &result)
 {
-    //Don't sync hidden files
-    if (items.at(itemID).hide == HideState::IHIDE)
-        return;
-    
-    //BanSleep(2000);
-    string path = items.at(itemID).path;
+    if (result.cancelled && result.job.type != SyncJobType::ILOCALSCAN)
+        Message(ICON_INFORMATION, "Info", "The sync has been cancelled.", 1000);
 
-    if (items.at(itemID).type == Itemtype::IFOLDER)
+    switch (result.job.type)
     {
-        vector<WebDAVItem> tempItems;
-        switch(items.at(itemID).state)
-        {
-            case FileState::IOUTSYNCED:
-            case FileState::ICLOUD:
+        case SyncJobType::ILISTFOLDER:
+            {
+                if (result.job.path != _pendingPath)
                 {
-                    UpdateProgressbar(("Syncing folder" + path).c_str(), 0);
-                    iv_mkdir(items.at(itemID).localPath.c_str(), 0777);
-                    tempItems = _webDAV.getDataStructure(path);
-                    items.at(itemID).state = FileState::IDOWNLOADED;
-                    _sqllite.updateState(items.at(itemID).path,items.at(itemID).state);
-                    updateItems(tempItems);
+                    //the shown listing is refreshed, otherwise the user has moved on in the meantime
+                    if (result.success && result.changed && _webDAVView != nullptr && _pendingPath.empty() && result.job.path == _currentPath)
+                    {
+                        Log::writeInfoLog("Refreshed the stored listing of " + result.job.path);
+                        drawStoredItems(_currentPath, _webDAVView->getShownPage());
+                    }
                     break;
                 }
-            case FileState::ISYNCED:
+                _pendingPath.clear();
+                HideHourglass();
+
+                //folders that have never been synced have no stored children
+                if (result.success || _sqllite->getState(result.job.path) != FileState::ICLOUD)
                 {
-                    tempItems = _sqllite.getItemsChildren(path);
-                    iv_mkdir(items.at(itemID).localPath.c_str(), 0777);
-                    items.at(itemID).state = FileState::IDOWNLOADED;
-                    _sqllite.updateState(items.at(itemID).path,items.at(itemID).state);
-                    break;
+                    if (drawStoredItems(result.job.path))
+                        break;
                 }
-            case FileState::ILOCAL:
+
+                if (_webDAVView != nullptr)
                 {
-                    if(items.at(itemID).localPath.length() > 3 && items.at(itemID).localPath.substr(items.at(itemID).localPath.length() - 3).compare("sdr") == 0)
-                        Log::writeInfoLog("Ignoring koreader file " + items.at(itemID).localPath);
-                    else
+                    Message(ICON_ERROR, "Error", "Could not sync the items and there is no offline copy available.", 2000);
+                    _webDAVView->invertCurrentEntryColor();
+                }
+                else if (_fileView != nullptr)
+                {
+                    Message(ICON_ERROR, "Error", "Failed to get items. Please try again.", 1000);
+                }
+                else
+                {
+                    int dialogResult = DialogSynchro(ICON_QUESTION, "Action", "Could not login and there is no DB available to restore information. What would you like to do?", "Logout", "Close App", NULL);
+                    switch (dialogResult)
                     {
-                        CloseProgressbar();
-
-                        int dialogResult = DialogSynchro(ICON_QUESTION, "Action", ("The folder " + items.at(itemID).localPath + " has been removed from the cloud. Do you want to delete it?").c_str(), "Yes", "No", "Cancel");
-                        if(dialogResult == 1)
-                            fs::remove_all(items.at(itemID).localPath);
-                        else
-                            tempItems.push_back(items.at(itemID));
-
-                        OpenProgressbar(1, "Downloading...", "", 0, NULL);
+                        case 1:
+                            {
+                                logout(true);
+                                _loginView = std::unique_ptr<LoginView>(new LoginView(_menu->getContentRect()));
+                            }
+                            break;
+                        case 2:
+                        default:
+                            CloseApp();
+                            break;
                     }
-                    break;
                 }
-            default:
                 break;
-        }
-
-        if(!tempItems.empty())
-        {
-            getLocalFileStructure(tempItems);
-            //first item of the vector is the root path itself
-            for (size_t i = 1; i < tempItems.size(); i++)
-                downloadFolder(tempItems, i);
-        }
-
-        //compare if file is in DB
-        //if file is not in DB, upload
-        //if file is in DB but no longer in Cloud, delete (if file local is newer prompt?)
-        //if file is newer offline, upload
-        //delete in DB if folder is no longer synced
-        //TODO remove file parts that are no longer there, check for local path and delete these
-    }
-    else
-    {
-        switch(items.at(itemID).state)
-        {
-            case FileState::IOUTSYNCED:
-            case FileState::ICLOUD:
+            }
+        case SyncJobType::IDOWNLOAD:
+        case SyncJobType::ITRANSFERS:
+            {
+                askToDeleteLocalItems(result.removedFromCloud);
+                //TODO implement
+                //Util::updatePBLibrary(15);
+                string parentPath = result.job.path.substr(0, result.job.path.find_last_of('/', result.job.path.length() - 2) + 1);
+                if (_webDAVView != nullptr && _pendingPath.empty() && (result.changed || parentPath == _currentPath))
                 {
-                    //TODO both direction
-                    //1. check etag --> if is differnt, cloud has been updated
-                    //2. check modification date and file size locally --> if is different, local has been updated
-                    //3. if both --> create conflict
-                    //4. if first, renew file --> reset etag
-                    //5. if second --> upload the local file; test if it has not been update in the cloud
-                    Log::writeInfoLog("started download of " + items.at(itemID).path + " to " + items.at(itemID).localPath);
-                    if (_webDAV.get(items.at(itemID))) {
-                        items.at(itemID).state = FileState::ISYNCED;
-                        _sqllite.updateState(items.at(itemID).path,items.at(itemID).state);
-                    }
-                    break;
+                    applyLocalChanges();
+                    drawStoredItems(_currentPath, _webDAVView->getShownPage());
                 }
-            case FileState::ILOCAL:
+                break;
+            }
+        case SyncJobType::IRECONCILE:
+            {
+                if (_webDAVView != nullptr && _pendingPath.empty() && result.job.path == _currentPath)
+                    drawStoredItems(_currentPath, _webDAVView->getShownPage());
+                break;
+            }
+        case SyncJobType::IUPLOAD:
+            {
+                //the uploaded items are stored and shown as synced
+                if (_webDAVView != nullptr && _pendingPath.empty() && result.job.path == _currentPath)
                 {
-                    CloseProgressbar();
-                    int dialogResult = DialogSynchro(ICON_QUESTION, "Action", ("The file " + items.at(itemID).localPath + " has been removed from the cloud. Do you want to delete it?").c_str(), "Yes", "No", "Cancel");
-                    if(dialogResult == 1)
-                        fs::remove(items.at(itemID).localPath);
-                    break;
-                    OpenProgressbar(1, "Downloading...", "", 0, NULL);
+                    applyLocalChanges();
+                    drawStoredItems(_currentPath, _webDAVView->getShownPage());
                 }
-            default:
                 break;
-        }
+            }
+        case SyncJobType::ILOCALSCAN:
+            {
+                _localScanPending = false;
+                //the storage location has changed during the scan, it is scanned again
+                if (result.localWatcher && !_localRescan)
+                    _localWatcher = result.localWatcher;
+                //changes made during the scan are read with the next poll
+                _sqllite->setLocalStatesTracked(_localWatcher->isComplete());
+                _worker->setLocalStatesTracked(_localWatcher->isComplete());
+                break;
+            }
     }
-
-
-    return;
 }
 
-void EventHandler::startDownload()
+void EventHandler::askToDeleteLocalItems(const vector<WebDAVItem> &items)
 {
-    OpenProgressbar(1, "Downloading...", "Starting Download.", 0, NULL);
-
-    if (_webDAVView->getCurrentEntry().type == Itemtype::IFILE)
-    {
-        Log::writeInfoLog("Started download of " + _webDAVView->getCurrentEntry().path + " to " + _webDAVView->getCurrentEntry().localPath);
-        if (_webDAV.get(_webDAVView->getCurrentEntry()))
-        {
-            _webDAVView->getCurrentEntry().state = FileState::ISYNCED;
-            _sqllite.updateState(_webDAVView->getCurrentEntry().path,_webDAVView->getCurrentEntry().state);
-        }
-    }
-    else
+    for (const auto &item : items)
     {
-        vector<WebDAVItem> currentItems = _sqllite.getItemsChildren(_webDAVView->getCurrentEntry().path);
-        this->downloadFolder(currentItems, 0);
-        _webDAVView->getCurrentEntry().state = FileState::IDOWNLOADED;
-        _sqllite.updateState(_webDAVView->getCurrentEntry().path,_webDAVView->getCurrentEntry().state);
-        UpdateProgressbar("Download completed", 100);
-    }
+        bool folder = item.type == Itemtype::IFOLDER;
+        int dialogResult = DialogSynchro(ICON_QUESTION, "Action", ("The " + string(folder ? "folder " : "file ") + item.localPath + " has been removed from the cloud. Do you want to delete it?").c_str(), "Yes", "No", "Cancel");
+        if (dialogResult == 3)
+            break;
+        if (dialogResult != 1)
+            continue;
 
-    //TODO implement
-    //Util::updatePBLibrary(15);
-    CloseProgressbar();
-    _webDAVView->reDrawCurrentEntry();
+        if (folder)
+            fs::remove_all(item.localPath);
+        else
+            fs::remove(item.localPath);
+    }
 }
 
-bool EventHandler::checkIfIsDownloaded(vector<WebDAVItem> &items, int itemID)
+bool EventHandler::drawStoredItems(const string &path, int page)
 {
-    if (iv_access(items.at(itemID).localPath.c_str(), W_OK) != 0)
-    {
-        items.at(itemID).state = items.at(itemID).type == Itemtype::IFOLDER ? items.at(itemID).state = FileState::ISYNCED : items.at(itemID).state = FileState::IOUTSYNCED;
-        _sqllite.updateState(items.at(itemID).path,items.at(itemID).state);
+    vector<WebDAVItem> items = _sqllite->getItemsChildren(path);
+    if (items.empty())
         return false;
-    }
-
-    if (items.at(itemID).type == Itemtype::IFOLDER)
-    {
-        if(items.at(itemID).state != FileState::IDOWNLOADED)
-            return false;
-        vector<WebDAVItem> tempItems = _sqllite.getItemsChildren(items.at(itemID).path);
-        //first item of the vector is the root path itself
-        for (auto i = 1; i < tempItems.size(); i++)
-        {
-            if(!checkIfIsDownloaded(tempItems, i))
-            {
-                items.at(itemID).state = FileState::ISYNCED;
-                _sqllite.updateState(items.at(itemID).path,items.at(itemID).state);
-                return false;
-            }
-        }
-    }
+    drawWebDAVItems(items, page);
     return true;
 }
 
-void EventHandler::updateItems(vector<WebDAVItem> &items)
+void EventHandler::drawWebDAVItems(vector<WebDAVItem> &items, int page)
 {
-    for(auto &item : items)
-    {
-        //returns ICloud if is not found
-        item.state = _sqllite.getState(item.path);
-
-        if (item.type == Itemtype::IFILE)
-        {
-            if (iv_access(item.localPath.c_str(), W_OK) != 0)
-                item.state = FileState::ICLOUD;
-            else
-            {
-                item.state = FileState::ISYNCED;
-                if (_sqllite.getEtag(item.path).compare(item.etag) != 0)
-                    item.state = FileState::IOUTSYNCED;
-            }
-        }
-        else
-        {
-            if (_sqllite.getEtag(item.path).compare(item.etag) != 0)
-                item.state = (item.state == FileState::ISYNCED || item.state == FileState::IDOWNLOADED) ? FileState::IOUTSYNCED : FileState::ICLOUD;
-            if(item.state == FileState::IDOWNLOADED)
-            {
-                vector<WebDAVItem> currentItems = _sqllite.getItemsChildren(item.path);
-                if(!checkIfIsDownloaded(currentItems,0))
-                    item.state = FileState::ISYNCED;
-            }
+    _currentPath = items.at(0).path;
+    FileBrowser::addLocalItems(items, *_fileHandler);
+    //the listing replaces the file picker and the login
+    _fileView.reset();
+    _loginView.reset();
+    _webDAVView.reset(new WebDAVView(_menu->getContentRect(), items, page));
 
-            if (iv_access(item.localPath.c_str(), W_OK) != 0)
-                iv_mkdir(item.localPath.c_str(), 0777);
-        }
+    if (!_firstScreenShown)
+    {
+        _firstScreenShown = true;
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count();
+        Log::writeInfoLog("Time to first screen: " + std::to_string(duration) + " ms");
     }
-    if(items.at(0).state != FileState::IDOWNLOADED)
-        items.at(0).state = FileState::ISYNCED;
-    _sqllite.saveItemsChildren(items);
-
-    //TODO sync delete when not parentPath existend --> "select * from metadata where parentPath NOT IN (Select
-    //DISTINCT(parentPath) from metadata;
-    //what happens with the entries below?
-}
-
-
-void EventHandler::drawWebDAVItems(vector<WebDAVItem> &items)
-{
-    _currentPath = items.at(0).path;
-    getLocalFileStructure(items);
-    _webDAVView.reset(new WebDAVView(_menu->getContentRect(), items,1));
 }
@@ -19,11 +19,19 @@
 #include "sqliteConnector.h"
 #include "log.h"
 #include "fileHandler.h"
+#include "localWatcher.h"
+#include "syncWorker.h"
 
 #include <memory>
+#include <chrono>
 
 const std::string CONFIG_FOLDER = "/mnt/ext1/system/config/nextcloud";
 const std::string DB_PATH = CONFIG_FOLDER + "/data.db";
+//items whose hide state is evaluated per timer call and the pause between the calls in ms
+const int HIDESTATES_BATCH = 500;
+const int HIDESTATES_INTERVAL = 200;
+//pause between reading the local changes in ms
+const int LOCALCHANGES_INTERVAL = 2000;
 
 class EventHandler
 {
@@ -46,6 +54,9 @@ public:
 
 private:
     static std::unique_ptr<EventHandler> _eventHandlerStatic;
+    //start of the app to measure the time until the first listing is usable, set before the DB is opened
+    std::chrono::steady_clock::time_point _startTime = std::chrono::steady_clock::now();
+    bool _firstScreenShown = false;
     std::unique_ptr<WebDAVView> _webDAVView;
     std::unique_ptr<LoginView> _loginView;
     std::unique_ptr<FileView> _fileView;
@@ -56,8 +67,53 @@ private:
 
     ContextMenu _contextMenu = ContextMenu();
     WebDAV _webDAV = WebDAV();
-    SqliteConnector _sqllite = SqliteConnector(DB_PATH);
+    std::unique_ptr<SqliteConnector> _sqllite = std::unique_ptr<SqliteConnector>(new SqliteConnector(DB_PATH));
+    //has to be created after the DB as it opens an own connection to it
+    std::unique_ptr<SyncWorker> _worker = std::unique_ptr<SyncWorker>(new SyncWorker(DB_PATH));
     std::string _currentPath;
+    //folder whose listing is requested from the worker and shown once it is received
+    std::string _pendingPath;
+    //replaced by the watcher of every scan, the worker starts it while scanning
+    std::shared_ptr<LocalWatcher> _localWatcher = std::shared_ptr<LocalWatcher>(new LocalWatcher());
+    //set if the storage location has to be scanned completely, e.g. after the app has been closed
+    bool _localRescan = true;
+    //set while the worker scans the storage location
+    bool _localScanPending = false;
+
+    /**
+        * Timer function that evaluates the next batch of outdated hide states
+        */
+    static void hideStatesTimerStatic();
+
+    /**
+        * Evaluates a batch of hide states that belong to older exclusion rules and schedules the next batch if there are more
+        */
+    void updateHideStates();
+
+    /**
+        * Timer function that records the local changes
+        */
+    static void localChangesTimerStatic();
+
+    /**
+        * Records the local changes or scans the storage location if changes could have been missed
+        */
+    void recordLocalChanges();
+
+    /**
+        * Lets the worker watch the storage location and compare the files with the stored states
+        */
+    void rescanLocalFiles();
+
+    /**
+        * Reads the pending events of the watcher into the journal
+        */
+    void pollLocalChanges();
+
+    /**
+        * Applies the recorded local changes to the stored states so that they can be used instead of checking the files
+        */
+    void applyLocalChanges();
 
     /**
         * Function needed to call C function, redirects to real function
@@ -127,17 +183,66 @@ private:
         */
     int keyHandler(const int type, const int par1, const int par2);
 
-    void getLocalFileStructure(std::vector<WebDAVItem> &tempItems);
+    /**
+        * Hands a job to the sync worker, the network is connected before as this can show dialogs
+        *
+        * @param job job that shall be run in the background
+        */
+    void pushJob(const SyncJob &job);
 
-    void downloadFolder(std::vector<WebDAVItem> &items, int itemID);
+    /**
+        * Requests the folder from the server, it is shown once the worker has stored it
+        *
+        * @param path folder that shall be shown
+        */
+    void requestFolder(const std::string &path);
 
-    void startDownload();
+    /**
+        * Continues the downloads that are left in the queue, e.g. from the last session
+        */
+    void resumeTransfers();
 
-    bool checkIfIsDownloaded(std::vector<WebDAVItem> &items, int itemID);
+    /**
+        * Logs out and opens the connections to the new DB, they are closed before as the DB file is deleted
+        *
+        * @param deleteFiles true if the local files of the user shall be deleted
+        */
+    void logout(bool deleteFiles);
 
-    void updateItems(std::vector<WebDAVItem> &items);
+    /**
+        * Shows the progress, the messages and the results of the sync worker
+        */
+    void handleWorkerEvent();
+
+    /**
+        * Shows the result of a job of the sync worker
+        *
+        * @param result finished job
+        */
+    void handleJobResult(SyncJobResult &result);
+
+    /**
+        * Asks for local items that have been removed from the cloud if they shall be deleted
+        *
+        * @param items local items whose remote copy is gone
+        */
+    void askToDeleteLocalItems(const std::vector<WebDAVItem> &items);
+
+    /**
+        * Shows the stored items of the folder
+        *
+        * @param path folder that shall be shown
+        * @param page page that is shown
+        * @return false if no items are stored
+        */
+    bool drawStoredItems(const std::string &path, int page = 1);
+
+    /**
+        * Hands the download of the current entry to the sync worker
+        */
+    void startDownload();
 
-    void drawWebDAVItems(std::vector<WebDAVItem> &items);
+    void drawWebDAVItems(std::vector<WebDAVItem> &items, int page = 1);
 
 };
 #endif
@@ -13,78 +13,101 @@
 
 #include <sstream>
 #include <regex>
-#include <algorithm>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 using std::string;
-using std::find;
-using std::regex;
 
-std::vector<FileHandler*> FileHandler::_instances;
-FileHandler::FileHandler()
+namespace
 {
-    _instances.push_back(this);
-
-    parseConfig(
-        Util::getConfig<string>("ex_pattern", ""),
-        Util::getConfig<string>("ex_folderPattern", ""),
-        Util::getConfig<string>("ex_extensionList", ""),
-        Util::getConfig<int>("ex_invertMatch", 0)
-    );
-
+    std::shared_ptr<const ExclusionRules> currentRules;
+    std::atomic<bool> rulesOutdated(true);
+    std::mutex rulesMutex;
+    bool listenerRegistered = false;
 }
 
-void FileHandler::parseConfig(string regex, string folderRegex, string extensions, int invertMatch) {
-    _extensions.clear();
+ExclusionRules::ExclusionRules(const string &regex, const string &folderRegex, const string &extensions, int invertMatch)
+{
     // split the comma seperated string
     if (!extensions.empty()) {
         string line;
 
         std::stringstream ss(extensions);
         while(getline(ss, line, ',')) {
-            _extensions.push_back(line);
+            _extensions.insert(line);
         }
     }
 
     // parse the regex only onces
     if (!regex.empty()) {
         try {
-            _regex = std::regex(regex);
+            _regex = DfaRegex(regex);
             _useRegex = true;
         } catch(std::regex_error err) {
             Log::writeErrorLog("Unable to parse regex '" + regex + "' for file: " + err.what());
         }
-    } else {
-        _useRegex = false;
     }
 
     if (!folderRegex.empty()) {
         try {
-            _folderRegex = std::regex(folderRegex);
+            _folderRegex = DfaRegex(folderRegex);
             _useFolderRegex = true;
         } catch(std::regex_error err) {
             Log::writeErrorLog("Unable to parse regex '" + folderRegex + "' for folder: " + err.what());
         }
-    } else {
-        _useFolderRegex = false;
     }
 
     _invertMatch = invertMatch;
+
+    // FNV-1a of the rules so that the version does not depend on the standard library
+    _version = 2166136261u;
+    for (const string &part : {regex, string(1, '\0'), folderRegex, string(1, '\0'), extensions, string(1, '\0'), std::to_string(invertMatch)})
+    {
+        for (unsigned char c : part)
+        {
+            _version ^= c;
+            _version *= 16777619u;
+        }
+    }
 }
 
-FileHandler::~FileHandler() 
+std::shared_ptr<const ExclusionRules> ExclusionRules::current()
 {
-    _instances.erase(std::remove(_instances.begin(), _instances.end(), this), _instances.end());
+    if (rulesOutdated.load())
+    {
+        std::lock_guard<std::mutex> lock(rulesMutex);
+        if (rulesOutdated.load())
+        {
+            if (!listenerRegistered)
+            {
+                // the entries are written one after another, therefore the rules are only marked and compiled on the next access
+                Util::addConfigListener([](const string &name) {
+                    if (name == "ex_pattern" || name == "ex_folderPattern" || name == "ex_extensionList" || name == "ex_invertMatch")
+                        rulesOutdated.store(true);
+                });
+                listenerRegistered = true;
+            }
+            rulesOutdated.store(false);
+            std::shared_ptr<const ExclusionRules> rules = std::make_shared<const ExclusionRules>(
+                Util::getConfig<string>("ex_pattern", ""),
+                Util::getConfig<string>("ex_folderPattern", ""),
+                Util::getConfig<string>("ex_extensionList", ""),
+                Util::getConfig<int>("ex_invertMatch", 0)
+            );
+            std::atomic_store(&currentRules, rules);
+        }
+    }
+    return std::atomic_load(&currentRules);
 }
 
-bool FileHandler::excludeFile(std::string filename) {
+bool ExclusionRules::excludeFile(const std::string &filename) const {
 
     // check for file extensions
     if (!_extensions.empty()) {
-        int indexOfDot = filename.find_last_of(".");
+        size_t indexOfDot = filename.find_last_of(".");
         if (indexOfDot != std::string::npos && filename.length() > indexOfDot + 1) {
-            string extension = filename.substr(filename.find_last_of(".") + 1);
-            if(std::find(_extensions.begin(),_extensions.end(), extension) != _extensions.end()) {
+            if (_extensions.find(filename.substr(indexOfDot + 1)) != _extensions.end()) {
                 return !_invertMatch;
             }
         }
@@ -92,7 +115,7 @@ bool FileHandler::excludeFile(std::string filename) {
 
     if (_useRegex) {
         try {
-            bool t = std::regex_match(filename, _regex) != _invertMatch;
+            bool t = _regex.match(filename) != _invertMatch;
             return t;
         } catch (std::regex_error err) {
             string errM = err.what();
@@ -103,9 +126,7 @@ bool FileHandler::excludeFile(std::string filename) {
     return _invertMatch;
 }
 
-bool FileHandler::excludeFolder(std::string folderName) {
-    folderName = "/" + folderName;
-
+bool ExclusionRules::excludeFolder(const std::string &folderName) const {
     // always display root folder because that can't be matched
     if (folderName == "/" || folderName == "//") {
         return false;
@@ -113,7 +134,7 @@ bool FileHandler::excludeFolder(std::string folderName) {
 
     if (_useFolderRegex) {
         try {
-            bool t = std::regex_match(folderName, _folderRegex) != _invertMatch;
+            bool t = _folderRegex.match(folderName) != _invertMatch;
             return t;
         } catch (std::regex_error err) {
             string errM = err.what();
@@ -124,16 +145,43 @@ bool FileHandler::excludeFolder(std::string folderName) {
     return _invertMatch;
 }
 
-HideState FileHandler::getHideState(Itemtype itemType, std::string prefix, std::string path, std::string title = "") {
+bool FileHandler::excludeFile(const std::string &filename) {
+    return ExclusionRules::current()->excludeFile(filename);
+}
+
+bool FileHandler::excludeFolder(const std::string &foldername) {
+    std::shared_ptr<const ExclusionRules> rules = ExclusionRules::current();
+    string folderName = "/" + foldername;
+
+    if (rules->getVersion() != _verdictVersion) {
+        _folderVerdicts.clear();
+        _verdictVersion = rules->getVersion();
+    }
+
+    auto verdict = _folderVerdicts.find(folderName);
+    if (verdict != _folderVerdicts.end())
+        return verdict->second;
+
+    bool t = rules->excludeFolder(folderName);
+    // bounded as the folders of a large library would otherwise all stay in memory
+    if (_folderVerdicts.size() > 10000)
+        _folderVerdicts.clear();
+    _folderVerdicts.emplace(folderName, t);
+    return t;
+}
+
+HideState FileHandler::getHideState(Itemtype itemType, const std::string &prefix, const std::string &path, const std::string &title) {
 
-    string folderPath = path;
+    string folderPath = "/";
     if (path.find(prefix) != string::npos) {
-         folderPath = path.substr(prefix.length());
-        if (itemType == Itemtype::IFILE && folderPath.length() >= title.length()) {
-            folderPath = folderPath.substr(0, folderPath.length() - title.length());
+        size_t length = path.length() - prefix.length();
+        if (itemType == Itemtype::IFILE && length >= title.length()) {
+            length -= title.length();
         }
+        folderPath.append(path, prefix.length(), length);
+    } else {
+        folderPath.append(path);
     }
-    folderPath = "/" + folderPath;
 
     if (itemType == Itemtype::IFILE) {
         if (!excludeFolder(folderPath) && !excludeFile(title)) {
@@ -151,12 +199,6 @@ HideState FileHandler::getHideState(Itemtype itemType, std::string prefix, std::
 }
 
 
-void FileHandler::update(string regex, string folderRegex, string extensions, int invertMatch) {
-    for (FileHandler *handler : _instances) {
-        handler->parseConfig(regex, folderRegex, extensions, invertMatch);
-    }
-}
-
 string FileHandler::getStorageLocation() {
     return Util::getConfig<string>("storageLocation") + getStorageUsername() + "/";
 }
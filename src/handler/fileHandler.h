@@ -10,37 +10,65 @@
 #define FILEHANDLER
 
 #include "webDAVModel.h"
+#include "dfaRegex.h"
 
-#include <regex>
 #include <string>
 #include <vector>
+#include <unordered_set>
+#include <unordered_map>
 
 #include <memory>
 
-class FileHandler
+/**
+ * Compiled exclusion rules of the config, a snapshot is never changed after it has been created
+ * and can therefore be shared between threads
+ */
+class ExclusionRules
 {
     public:
-        FileHandler();
-        ~FileHandler();
-        bool excludeFile(std::string filename);
-        bool excludeFolder(std::string foldername);
-        HideState getHideState(Itemtype itemType, std::string prefixToStripe, std::string path, std::string title);
+        ExclusionRules(const std::string &regex, const std::string &folderRegex, const std::string &extensions, int invertMatch);
 
-        std::string getStorageLocation();
-        std::string getStorageUsername();
-        static void update(std::string regex, std::string folderRegex, std::string extensions, int invertMatch);
+        bool excludeFile(const std::string &filename) const;
+
+        /**
+         * @param folderName path of the folder beginning with a slash
+         */
+        bool excludeFolder(const std::string &folderName) const;
+
+        /**
+         * Returns a version that only changes if the rules change, it is derived from the rules and stays the same after restarts
+         */
+        unsigned int getVersion() const { return _version; };
+
+        /**
+         * Returns the rules of the config, they are only compiled again after an exclusion entry of the config has changed
+         */
+        static std::shared_ptr<const ExclusionRules> current();
 
     private:
-        std::regex              _regex;
-        std::regex              _folderRegex;
-        // can't use pointers with regex... Why? -> unable to null check
+        DfaRegex                _regex;
+        DfaRegex                _folderRegex;
         bool                    _useRegex = false;
         bool                    _useFolderRegex = false;
-        std::vector<std::string> _extensions;
+        std::unordered_set<std::string> _extensions;
         bool                     _invertMatch;
+        unsigned int             _version;
+};
 
-        void parseConfig(std::string regex, std::string folderRegex, std::string extensions, int invertMatch);
-        static std::vector<FileHandler *> _instances;
+class FileHandler
+{
+    public:
+        bool excludeFile(const std::string &filename);
+        bool excludeFolder(const std::string &foldername);
+        HideState getHideState(Itemtype itemType, const std::string &prefixToStripe, const std::string &path, const std::string &title);
+
+        std::string getStorageLocation();
+        std::string getStorageUsername();
+
+    private:
+        // the items of a folder share the verdict of the folder
+        std::unordered_map<std::string, bool> _folderVerdicts;
+        unsigned int _verdictVersion = 0;
 
 };
-#endif
\ No newline at end of file
+#endif
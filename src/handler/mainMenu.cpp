@@ -46,6 +46,7 @@ MainMenu::~MainMenu()
     free(_info);
     free(_exit);
     free(_chooseFolder);
+    free(_cancelSync);
 }
 
 void MainMenu::panelHandlerStatic()
@@ -54,13 +55,27 @@ void MainMenu::panelHandlerStatic()
     SetHardTimer("PANELUPDATE", panelHandlerStatic, 110000);
 }
 
-int MainMenu::createMenu(bool filePicker, bool loggedIn, iv_menuhandler handler)
+void MainMenu::setStatus(const string &status)
+{
+    //the name of the app is centered, the status uses the free space on the left
+    FillArea(0, _panelMenuBeginY, _mainMenuWidth, _panelMenuHeight - 1, WHITE);
+    if (!status.empty())
+    {
+        SetFont(_menuFont, BLACK);
+        DrawTextRect(0, _panelMenuBeginY, _mainMenuWidth, _panelMenuHeight - 1, status.c_str(), ALIGN_LEFT | VALIGN_MIDDLE | DOTS);
+    }
+    PartialUpdate(0, _panelMenuBeginY, _mainMenuWidth, _panelMenuHeight);
+}
+
+int MainMenu::createMenu(bool filePicker, bool loggedIn, bool syncRunning, iv_menuhandler handler)
 {
     imenu mainMenu[] =
         {
             {ITEM_HEADER, 0, _menu, NULL},
             //show logged in
             {loggedIn ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 101, _syncFolder, NULL},
+            //show while syncing
+            {syncRunning ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 108, _cancelSync, NULL},
             {loggedIn ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 103, _sortBy, NULL},
             {loggedIn ? (short)ITEM_ACTIVE : (short)ITEM_HIDDEN, 104, _excludeFiles, NULL},
             //show if filePicker is shown
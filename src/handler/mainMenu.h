@@ -33,10 +33,18 @@ public:
         *
         * @param filePicker true if the filepicker is shown
         * @param loogedIn the status if the user is logged in
+        * @param syncRunning true if a sync job is running or queued
         * @param handler handles the clicks on the menu
         * @return int returns if the event was handled
         */
-    int createMenu(bool filePicker, bool loggedIn, iv_menuhandler handler);
+    int createMenu(bool filePicker, bool loggedIn, bool syncRunning, iv_menuhandler handler);
+
+    /**
+        * Shows the progress of the background sync in the menubar
+        *
+        * @param status text that is shown, empty to clear it
+        */
+    void setStatus(const std::string &status);
 
 private:
     ifont *_menuFont;
@@ -58,6 +66,7 @@ private:
     char *_excludeFiles = strdup("Exclude and hide items");
     char *_info = strdup("Info");
     char *_exit = strdup("Close App");
+    char *_cancelSync = strdup("Cancel sync");
 
     /**
         * Functions needed to call C function, handles the panel
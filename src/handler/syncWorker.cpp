@@ -0,0 +1,788 @@
+//------------------------------------------------------------------
+// syncWorker.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "syncWorker.h"
+#include "inkview.h"
+#include "util.h"
+#include "log.h"
+#include "fileBrowser.h"
+
+#include <experimental/filesystem>
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <deque>
+#include <chrono>
+#include <ctime>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    //states of files that exist locally
+    bool isLocalState(FileState state)
+    {
+        return state == FileState::ISYNCED || state == FileState::IOUTSYNCED;
+    }
+}
+
+SyncWorker::SyncWorker(const string &dbPath) : _dbPath(dbPath), _task(GetCurrentTask())
+{
+    _configListener = Util::addConfigListener([this](const string &name) {
+        if (name == "url" || name == "username" || name == "password" || name == "UUID" || name == "ignoreCert")
+            _reloadWebDAV = true;
+    });
+    _thread = std::thread(&SyncWorker::run, this);
+}
+
+SyncWorker::~SyncWorker()
+{
+    Util::removeConfigListener(_configListener);
+    cancel();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void SyncWorker::push(const SyncJob &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        //a new job is not affected by an earlier cancel
+        if (!_running)
+            _cancel = false;
+        _jobs.push_back(job);
+    }
+    _condition.notify_one();
+}
+
+void SyncWorker::cancel()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.clear();
+    if (_running)
+        _cancel = true;
+}
+
+bool SyncWorker::isBusy()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running || !_jobs.empty();
+}
+
+SyncUpdate SyncWorker::takeUpdate()
+{
+    //events that are sent from now on contain news that are not part of this update
+    _eventPending = false;
+
+    SyncUpdate update;
+    std::lock_guard<std::mutex> lock(_mutex);
+    update.status = _status;
+    update.percent = _percent;
+    update.busy = _running || !_jobs.empty();
+    update.messages.swap(_messages);
+    update.results.swap(_results);
+    return update;
+}
+
+void SyncWorker::notify()
+{
+    if (!_eventPending.exchange(true))
+        SendEventTo(_task, SYNCWORKER_EVENT, 0, 0);
+}
+
+void SyncWorker::setStatus(const string &status, int percent)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_status == status && _percent == percent)
+            return;
+        _status = status;
+        _percent = percent;
+    }
+    notify();
+}
+
+void SyncWorker::addMessage(int icon, const string &title, const string &text, int timeout)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _messages.push_back(SyncMessage{icon, title, text, timeout});
+    }
+    notify();
+}
+
+void SyncWorker::createWebDAV()
+{
+    _reloadWebDAV = false;
+    _webDAV.reset(new WebDAV());
+    _webDAV->setHandlers(
+        [this](int icon, const string &title, const string &text, int timeout) { addMessage(icon, title, text, timeout); },
+        [this](const string &text, int percent) { setStatus(text, percent); });
+    _webDAV->setCancelFlag(&_cancel);
+}
+
+void SyncWorker::run()
+{
+    _sqllite.reset(new SqliteConnector(_dbPath));
+    _fileHandler = std::shared_ptr<FileHandler>(new FileHandler());
+    createWebDAV();
+
+    while (true)
+    {
+        SyncJobResult result;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this] { return _stop || !_jobs.empty(); });
+            if (_stop)
+                break;
+            result.job = _jobs.front();
+            _jobs.pop_front();
+            _running = true;
+        }
+
+        if (_reloadWebDAV)
+            createWebDAV();
+        _sqllite->setLocalStatesTracked(_localStatesTracked);
+
+        switch (result.job.type)
+        {
+            case SyncJobType::ILISTFOLDER:
+                setStatus("Loading " + result.job.path, 0);
+                result.success = listFolder(result.job.path, result);
+                break;
+            case SyncJobType::IDOWNLOAD:
+                setStatus("Starting Download.", 0);
+                result.success = download(result.job.item, result);
+                break;
+            case SyncJobType::ITRANSFERS:
+                result.success = processTransfers(result);
+                break;
+            case SyncJobType::IRECONCILE:
+                setStatus("Actualizing path " + result.job.path, 0);
+                result.success = reconcile(result.job.path);
+                break;
+            case SyncJobType::IUPLOAD:
+                setStatus("Starting Upload.", 0);
+                result.success = upload(result.job.item, result);
+                break;
+            case SyncJobType::ILOCALSCAN:
+                result.success = scanLocalFiles(result.job.path, result);
+                break;
+        }
+
+        //the failed requests of the job are shown at once instead of one message per request
+        ErrorReport report = _webDAV->takeReport();
+        if (!report.empty() && !_cancel)
+            addMessage(ICON_ERROR, "Error", report.summary(), 5000);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            result.cancelled = _cancel;
+            _cancel = false;
+            _running = false;
+            _status.clear();
+            _percent = 0;
+            _results.push_back(result);
+        }
+        notify();
+    }
+
+    _webDAV.reset();
+    _sqllite.reset();
+}
+
+bool SyncWorker::scanLocalFiles(const string &root, SyncJobResult &result)
+{
+    //the files are checked directly until the scan is done
+    _sqllite->setLocalStatesTracked(false);
+
+    auto start = std::chrono::steady_clock::now();
+    result.localWatcher = std::shared_ptr<LocalWatcher>(new LocalWatcher());
+    vector<string> found;
+    bool complete = result.localWatcher->start(root, found);
+    int changed = _sqllite->reconcileLocalFiles(std::unordered_set<string>(found.begin(), found.end()));
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    Log::writeInfoLog("Scanned " + std::to_string(found.size()) + " local items in " + std::to_string(duration) + " ms, " + std::to_string(changed) + " states changed");
+    return complete;
+}
+
+bool SyncWorker::isUnchanged(const string &path)
+{
+    FileState state = _sqllite->getState(path);
+    if (state != FileState::ISYNCED && state != FileState::IDOWNLOADED)
+        return false;
+    string storedEtag = _sqllite->getEtag(path);
+    return !storedEtag.empty() && _webDAV->getEtag(path) == storedEtag;
+}
+
+bool SyncWorker::listFolder(const string &path, SyncJobResult &result)
+{
+    if (isUnchanged(path))
+    {
+        Log::writeInfoLog("Stored listing of " + path + " is up to date");
+        return true;
+    }
+
+    vector<WebDAVItem> items = _webDAV->getDataStructure(path);
+    if (items.empty())
+        return false;
+    result.changed = updateItems(items);
+    return true;
+}
+
+bool SyncWorker::download(WebDAVItem &item, SyncJobResult &result)
+{
+    if (item.type == Itemtype::IFILE)
+    {
+        _sqllite->addTransfers({item}, TransferPriority::ITAPPED, "");
+        return processTransfers(result);
+    }
+
+    //the structure below the folder is requested at once, the walk below then only requests folders that could not be indexed
+    if (!indexTree(item.path) && _cancel)
+        return false;
+
+    vector<WebDAVItem> currentItems = _sqllite->getItemsChildren(item.path);
+    if (currentItems.empty())
+        return false;
+    vector<WebDAVItem> downloads;
+    downloadFolder(currentItems, 0, downloads, result);
+    if (_cancel)
+        return false;
+
+    //the queue survives the app, an interrupted download continues with the files that are left
+    Log::writeInfoLog("Queued " + std::to_string(downloads.size()) + " files of " + item.path);
+    _sqllite->addTransfers(downloads, TransferPriority::IFOLDER, item.path);
+    return processTransfers(result);
+}
+
+bool SyncWorker::processTransfers(SyncJobResult &result)
+{
+    _sqllite->cleanTransfers();
+    const vector<string> folders = _sqllite->getTransferFolders();
+    //files that failed in this run are not requested again until the next job
+    std::unordered_set<string> failed;
+
+    while (!_cancel)
+    {
+        vector<WebDAVItem> batch = _sqllite->getTransfers(TRANSFER_BATCH + failed.size());
+        batch.erase(std::remove_if(batch.begin(), batch.end(), [&failed](const WebDAVItem &item) { return failed.count(item.path) > 0; }), batch.end());
+        if (batch.empty())
+            break;
+        if (batch.size() > static_cast<size_t>(TRANSFER_BATCH))
+            batch.resize(TRANSFER_BATCH);
+
+        std::unordered_set<string> pending;
+        for (const auto &item : batch)
+            pending.insert(item.path);
+
+        _webDAV->getMultiple(batch, [this, &pending, &result](WebDAVItem &download) {
+            download.state = FileState::ISYNCED;
+            _sqllite->updateState(download.path, download.state);
+            _sqllite->updateLocalEtag(download.path, download.localEtag);
+            _sqllite->removeTransfer(download.path);
+            pending.erase(download.path);
+            result.changed = true;
+        });
+        //cancelled files are not counted as failed
+        if (_cancel)
+            break;
+
+        for (const auto &path : pending)
+        {
+            _sqllite->addTransferAttempt(path);
+            failed.insert(path);
+        }
+    }
+
+    for (const auto &folder : folders)
+    {
+        if (!_cancel && _sqllite->isSubtreeDownloaded(folder))
+        {
+            _sqllite->updateState(folder, FileState::IDOWNLOADED);
+            result.changed = true;
+        }
+    }
+
+    if (_cancel || !failed.empty())
+        return false;
+    setStatus("Download completed", 100);
+    return true;
+}
+
+bool SyncWorker::reconcile(const string &path)
+{
+    //one request for the whole tree if the server supports sync-tokens, otherwise walk the etags
+    if (syncChanges())
+        return true;
+    if (_cancel)
+        return false;
+
+    vector<WebDAVItem> currentWebDAVItems;
+    string childrenPath = path.substr(NEXTCLOUD_ROOT_PATH.length(), path.length());
+    string folderPath = NEXTCLOUD_ROOT_PATH;
+    size_t found = 0;
+    int i = 0;
+    while ((found = childrenPath.find("/")) != string::npos && !_cancel)
+    {
+        folderPath += childrenPath.substr(0, found + 1);
+        childrenPath = childrenPath.substr(found + 1, childrenPath.length());
+        auto state = _sqllite->getState(folderPath);
+        Log::writeInfoLog("cur path " + folderPath);
+        //the etag of the topmost folder tells if anything has changed at all, only folders that were outdated before are requested then
+        if (i < 1 && isUnchanged(folderPath))
+        {
+            Log::writeInfoLog("Nothing has changed below " + folderPath);
+            break;
+        }
+        if (i < 1 || state == FileState::IOUTSYNCED || state == FileState::ICLOUD)
+        {
+            setStatus("Upgrading " + folderPath, 0);
+            currentWebDAVItems = _webDAV->getDataStructure(folderPath);
+        }
+        else
+        {
+            break;
+        }
+
+        if (currentWebDAVItems.empty())
+        {
+            Log::writeErrorLog("Could not sync " + folderPath + " via actualize.");
+            break;
+        }
+        updateItems(currentWebDAVItems);
+        i++;
+    }
+
+    Log::writeInfoLog("stopped at " + folderPath);
+    currentWebDAVItems = _sqllite->getItemsChildren(path);
+
+    for (auto &item : currentWebDAVItems)
+    {
+        if (_cancel)
+            return false;
+        if (item.type == Itemtype::IFOLDER && item.state == FileState::IOUTSYNCED)
+        {
+            setStatus("Upgrading " + item.path, 0);
+            vector<WebDAVItem> tempWebDAVItems = _webDAV->getDataStructure(item.path);
+            if (!tempWebDAVItems.empty())
+                updateItems(tempWebDAVItems);
+        }
+    }
+    return true;
+}
+
+WebDAVItem SyncWorker::createUploadItem(const string &localPath, Itemtype type)
+{
+    WebDAVItem item;
+    item.localPath = localPath;
+    item.type = type;
+    item.path = WebDAV::getRemotePath(localPath, type == Itemtype::IFOLDER);
+    item.title = localPath.substr(localPath.find_last_of('/') + 1);
+    item.state = FileState::ISYNCED;
+
+    struct stat localStat;
+    if (stat(localPath.c_str(), &localStat) == 0)
+    {
+        gmtime_r(&localStat.st_mtime, &item.lastEditDate);
+        item.size = WebDAV::formatSize(type == Itemtype::IFILE ? localStat.st_size : 0);
+    }
+
+    string pathDecoded = item.path;
+    Util::decodeUrl(pathDecoded);
+    item.hideVersion = ExclusionRules::current()->getVersion();
+    item.hide = _fileHandler->getHideState(type, NEXTCLOUD_ROOT_PATH + Util::getConfig<string>("username") + "/", pathDecoded, item.title);
+    return item;
+}
+
+bool SyncWorker::upload(const WebDAVItem &item, SyncJobResult &result)
+{
+    //folders are created before the files inside them, parents before their children
+    vector<WebDAVItem> folders;
+    vector<WebDAVItem> files;
+    if (item.type == Itemtype::IFOLDER)
+    {
+        folders.push_back(createUploadItem(item.localPath, Itemtype::IFOLDER));
+        std::error_code error;
+        for (auto it = fs::recursive_directory_iterator(item.localPath, error); it != fs::recursive_directory_iterator(); it.increment(error))
+        {
+            if (error)
+                break;
+            const string localPath = it->path().string();
+            const bool folder = fs::is_directory(it->status());
+            //metadata of koreader and unfinished downloads stay on the device
+            if ((folder && localPath.length() > 4 && localPath.compare(localPath.length() - 4, 4, ".sdr") == 0) ||
+                (!folder && localPath.length() > 5 && localPath.compare(localPath.length() - 5, 5, ".part") == 0))
+            {
+                if (folder)
+                    it.disable_recursion_pending();
+                continue;
+            }
+
+            WebDAVItem localItem = createUploadItem(localPath, folder ? Itemtype::IFOLDER : Itemtype::IFILE);
+            if (localItem.hide == HideState::IHIDE)
+            {
+                if (folder)
+                    it.disable_recursion_pending();
+                continue;
+            }
+            (folder ? folders : files).push_back(localItem);
+        }
+        std::sort(folders.begin(), folders.end(), [](const WebDAVItem &a, const WebDAVItem &b) { return a.path < b.path; });
+    }
+    else
+    {
+        files.push_back(createUploadItem(item.localPath, Itemtype::IFILE));
+    }
+
+    vector<string> folderPaths;
+    for (const auto &folder : folders)
+        folderPaths.push_back(folder.path);
+    setStatus("Creating folders", 0);
+    if (!_webDAV->createFolders(folderPaths))
+        return false;
+    //the etag of a new folder is not part of the response, it is requested once the folder is opened
+    if (!folders.empty())
+    {
+        _sqllite->saveItems(folders);
+        result.changed = true;
+    }
+
+    size_t uploaded = 0;
+    for (auto &file : files)
+    {
+        if (_cancel)
+            return false;
+        setStatus("Uploading " + file.title, 0);
+        if (!_webDAV->put(file))
+            continue;
+        //the etag of the response belongs to the local version, so the file does not have to be listed again
+        file.localEtag = file.etag;
+        _sqllite->saveItems({file});
+        uploaded++;
+        result.changed = true;
+    }
+
+    Log::writeInfoLog("Uploaded " + std::to_string(uploaded) + " of " + std::to_string(files.size()) + " files of " + item.localPath);
+    if (uploaded < files.size())
+        return false;
+    setStatus("Upload completed", 100);
+    return true;
+}
+
+void SyncWorker::downloadFolder(vector<WebDAVItem> &items, int itemID, vector<WebDAVItem> &downloads, SyncJobResult &result)
+{
+    //Don't sync hidden files
+    if (items.at(itemID).hide == HideState::IHIDE || _cancel)
+        return;
+
+    string path = items.at(itemID).path;
+
+    if (items.at(itemID).type == Itemtype::IFOLDER)
+    {
+        vector<WebDAVItem> tempItems;
+        switch(items.at(itemID).state)
+        {
+            case FileState::IOUTSYNCED:
+            case FileState::ICLOUD:
+                {
+                    setStatus("Syncing folder " + path, 0);
+                    iv_mkdir(items.at(itemID).localPath.c_str(), 0777);
+                    tempItems = _webDAV->getDataStructure(path);
+                    if (tempItems.empty())
+                        break;
+                    items.at(itemID).state = FileState::IDOWNLOADED;
+                    _sqllite->updateState(items.at(itemID).path,items.at(itemID).state);
+                    updateItems(tempItems);
+                    break;
+                }
+            case FileState::ISYNCED:
+                {
+                    tempItems = _sqllite->getItemsChildren(path);
+                    iv_mkdir(items.at(itemID).localPath.c_str(), 0777);
+                    items.at(itemID).state = FileState::IDOWNLOADED;
+                    _sqllite->updateState(items.at(itemID).path,items.at(itemID).state);
+                    break;
+                }
+            case FileState::ILOCAL:
+                {
+                    if(items.at(itemID).localPath.length() > 3 && items.at(itemID).localPath.substr(items.at(itemID).localPath.length() - 3).compare("sdr") == 0)
+                        Log::writeInfoLog("Ignoring koreader file " + items.at(itemID).localPath);
+                    else
+                        result.removedFromCloud.push_back(items.at(itemID));
+                    break;
+                }
+            default:
+                break;
+        }
+
+        if(!tempItems.empty())
+        {
+            FileBrowser::addLocalItems(tempItems, *_fileHandler);
+            //first item of the vector is the root path itself
+            for (size_t i = 1; i < tempItems.size(); i++)
+                downloadFolder(tempItems, i, downloads, result);
+        }
+    }
+    else
+    {
+        switch(items.at(itemID).state)
+        {
+            case FileState::IOUTSYNCED:
+            case FileState::ICLOUD:
+                {
+                    downloads.push_back(items.at(itemID));
+                    break;
+                }
+            case FileState::ILOCAL:
+                {
+                    result.removedFromCloud.push_back(items.at(itemID));
+                    break;
+                }
+            default:
+                break;
+        }
+    }
+}
+
+bool SyncWorker::updateItems(vector<WebDAVItem> &items)
+{
+    //the stored state of tracked items tells if they exist locally
+    const bool tracked = _localStatesTracked;
+    const auto stored = _sqllite->getStoredChildren(items.at(0).path);
+    //items that are no longer on the server are removed from the listing
+    bool changed = stored.size() != items.size();
+    for(auto &item : items)
+    {
+        //items that are not stored yet are in the cloud and have no etag to compare
+        auto storedItem = stored.find(item.path);
+        bool etagChanged = true;
+        item.state = FileState::ICLOUD;
+        item.localEtag.clear();
+        if (storedItem != stored.end())
+        {
+            item.state = storedItem->second.state;
+            item.localEtag = storedItem->second.localEtag;
+            etagChanged = storedItem->second.etag.compare(item.etag) != 0;
+        }
+
+        const bool known = tracked && storedItem != stored.end();
+        if (item.type == Itemtype::IFILE)
+        {
+            bool local = known ? isLocalState(storedItem->second.state) : iv_access(item.localPath.c_str(), W_OK) == 0;
+            if (!local)
+                item.state = FileState::ICLOUD;
+            else
+            {
+                item.state = FileState::ISYNCED;
+                if (etagChanged)
+                    item.state = FileState::IOUTSYNCED;
+            }
+        }
+        else
+        {
+            if (etagChanged)
+                item.state = (item.state == FileState::ISYNCED || item.state == FileState::IDOWNLOADED) ? FileState::IOUTSYNCED : FileState::ICLOUD;
+            if(item.state == FileState::IDOWNLOADED && !_sqllite->isSubtreeDownloaded(item.path))
+                item.state = FileState::ISYNCED;
+
+            if (!known && iv_access(item.localPath.c_str(), W_OK) != 0)
+                iv_mkdir(item.localPath.c_str(), 0777);
+        }
+
+        if (storedItem == stored.end() || etagChanged || storedItem->second.state != item.state)
+            changed = true;
+    }
+    if(items.at(0).state != FileState::IDOWNLOADED)
+        items.at(0).state = FileState::ISYNCED;
+    _sqllite->saveItemsChildren(items);
+    return changed;
+}
+
+bool SyncWorker::syncChanges()
+{
+    string rootPath = WebDAV::getRootPath(true);
+    string newSyncToken;
+    vector<WebDAVItem> changed;
+    vector<string> removed;
+
+    setStatus("Requesting changes", 0);
+    switch (_webDAV->getChanges(rootPath, _sqllite->getSyncToken(rootPath), changed, removed, newSyncToken))
+    {
+        case SyncResult::ISUCCESS:
+            break;
+        case SyncResult::IINVALIDTOKEN:
+            //the next actualize requests all items again
+            _sqllite->setSyncToken(rootPath, "");
+            return false;
+        default:
+            return false;
+    }
+
+    for (const auto &path : removed)
+        _sqllite->deleteItem(path);
+
+    saveTreeItems(changed, rootPath);
+    _sqllite->setSyncToken(rootPath, newSyncToken);
+    return true;
+}
+
+void SyncWorker::saveTreeItems(vector<WebDAVItem> &items, const string &rootPath)
+{
+    const bool tracked = _localStatesTracked;
+
+    //the stored values are loaded once per folder of the changed items
+    std::unordered_map<string, std::unordered_map<string, StoredItem>> storedFolders;
+    auto getStored = [this, &storedFolders](const string &path) -> const StoredItem * {
+        string parent = path.substr(0, path.find_last_of('/', path.length() - 2) + 1);
+        auto folder = storedFolders.find(parent);
+        if (folder == storedFolders.end())
+            folder = storedFolders.emplace(parent, _sqllite->getStoredChildren(parent)).first;
+        auto storedItem = folder->second.find(path);
+        return storedItem != folder->second.end() ? &storedItem->second : nullptr;
+    };
+
+    //folders that contain files which are not downloaded can no longer be marked as downloaded
+    std::set<string> notDownloaded;
+    for (auto &item : items)
+    {
+        const StoredItem *stored = getStored(item.path);
+        const StoredItem storedItem = stored ? *stored : StoredItem{FileState::ICLOUD, "", ""};
+        const string &storedEtag = storedItem.etag;
+        item.localEtag = storedItem.localEtag;
+        if (item.type == Itemtype::IFILE)
+        {
+            bool local = (tracked && stored) ? isLocalState(stored->state) : iv_access(item.localPath.c_str(), W_OK) == 0;
+            if (!local)
+                item.state = FileState::ICLOUD;
+            else
+                item.state = (storedEtag.compare(item.etag) == 0) ? FileState::ISYNCED : FileState::IOUTSYNCED;
+
+            if (item.state != FileState::ISYNCED)
+            {
+                string parent = item.path;
+                while (parent.length() > rootPath.length())
+                {
+                    parent = parent.substr(0, parent.find_last_of('/', parent.length() - 2) + 1);
+                    notDownloaded.insert(parent);
+                }
+            }
+        }
+        else
+        {
+            //the changes below the folder are part of the response, so its structure is synced
+            item.state = (storedItem.state == FileState::IDOWNLOADED) ? FileState::IDOWNLOADED : FileState::ISYNCED;
+        }
+    }
+
+    for (auto &item : items)
+    {
+        if (item.type == Itemtype::IFOLDER && item.state == FileState::IDOWNLOADED && notDownloaded.erase(item.path) > 0)
+            item.state = FileState::ISYNCED;
+    }
+    for (const auto &path : notDownloaded)
+    {
+        if (_sqllite->getState(path) == FileState::IDOWNLOADED)
+            _sqllite->updateState(path, FileState::ISYNCED);
+    }
+
+    _sqllite->saveItems(items);
+}
+
+bool SyncWorker::indexTree(const string &path)
+{
+    const auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    int requests = 1;
+    std::unordered_set<string> seen;
+    auto onItems = [this, &path, &count, &seen](vector<WebDAVItem> &items) {
+        for (const auto &item : items)
+            seen.insert(item.path);
+        saveTreeItems(items, path);
+        count += items.size();
+        setStatus("Indexing " + path + " (" + std::to_string(count) + " items)", 0);
+    };
+
+    //one request for the whole tree, SEARCH is tried if a proxy or the server rejects Depth: infinity
+    setStatus("Indexing " + path, 0);
+    string method = "PROPFIND infinity";
+    SyncResult result = _webDAV->getTree(path, onItems);
+    if (result == SyncResult::IUNSUPPORTED && !_cancel)
+    {
+        method = "SEARCH";
+        seen.clear();
+        result = _webDAV->searchTree(path, onItems);
+    }
+
+    if (result == SyncResult::ISUCCESS)
+    {
+        //items that are not part of the response have been removed from the server
+        size_t removed = 0;
+        for (const auto &storedPath : _sqllite->getPathsBelow(path))
+        {
+            if (seen.count(storedPath) == 0)
+            {
+                _sqllite->deleteItem(storedPath);
+                removed++;
+            }
+        }
+        if (removed > 0)
+            Log::writeInfoLog("Removed " + std::to_string(removed) + " items below " + path + " that are no longer on the server");
+    }
+    else if (result == SyncResult::IUNSUPPORTED && !_cancel)
+    {
+        //folder by folder, folders whose etag has not changed are already indexed
+        method = "PROPFIND 1";
+        requests = 0;
+        std::deque<string> folders{path};
+        while (!folders.empty() && !_cancel)
+        {
+            const string folder = folders.front();
+            folders.pop_front();
+            setStatus("Indexing " + folder, 0);
+            vector<WebDAVItem> items = _webDAV->getDataStructure(folder);
+            requests++;
+            if (items.empty())
+            {
+                result = SyncResult::IFAILED;
+                break;
+            }
+            updateItems(items);
+            count += items.size();
+            //first item of the vector is the folder itself
+            for (size_t i = 1; i < items.size(); i++)
+            {
+                if (items.at(i).type == Itemtype::IFOLDER && (items.at(i).state == FileState::IOUTSYNCED || items.at(i).state == FileState::ICLOUD))
+                    folders.push_back(items.at(i).path);
+            }
+        }
+        if (folders.empty() && result != SyncResult::IFAILED && !_cancel)
+            result = SyncResult::ISUCCESS;
+    }
+
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    Log::writeInfoLog("Indexed " + std::to_string(count) + " items below " + path + " using " + method + " with " + std::to_string(requests) + " requests in " + std::to_string(duration.count()) + " ms");
+
+    if (result != SyncResult::ISUCCESS)
+        return false;
+    if (_sqllite->getState(path) != FileState::IDOWNLOADED)
+        _sqllite->updateState(path, FileState::ISYNCED);
+    return true;
+}
@@ -0,0 +1,265 @@
+//------------------------------------------------------------------
+// syncWorker.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Runs the requests to the server and the sync of the DB in its own thread
+//
+//-------------------------------------------------------------------
+
+#ifndef SYNCWORKER
+#define SYNCWORKER
+
+#include "inkview.h"
+#include "webDAV.h"
+#include "webDAVModel.h"
+#include "sqliteConnector.h"
+#include "fileHandler.h"
+#include "localWatcher.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+//event that is sent to the app if the worker has news for the UI thread
+const int SYNCWORKER_EVENT = EVT_CUSTOM;
+//files of the download queue that are read at once, the priorities are checked again before the next ones
+const int TRANSFER_BATCH = 20;
+
+enum class SyncJobType
+{
+    //requests a folder from the server and saves it to the DB
+    ILISTFOLDER,
+    //adds the files of a folder and everything below it to the download queue and downloads them
+    IDOWNLOAD,
+    //downloads the files of the download queue
+    ITRANSFERS,
+    //brings the DB of a folder and the folders above it up to date with the server
+    IRECONCILE,
+    //uploads a local file or folder with everything below it
+    IUPLOAD,
+    //watches the storage location given as path and compares the local files with the stored states
+    ILOCALSCAN
+};
+
+struct SyncJob
+{
+    SyncJobType type;
+    std::string path;
+    //item that shall be downloaded or uploaded
+    WebDAVItem item;
+};
+
+struct SyncJobResult
+{
+    SyncJob job;
+    bool success = false;
+    bool cancelled = false;
+    //the stored listing of the folder differs from the one received
+    bool changed = false;
+    //local items that have been removed from the cloud, the user is asked if they shall be deleted
+    std::vector<WebDAVItem> removedFromCloud;
+    //watcher started by the local scan, from then on it is polled by the UI thread
+    std::shared_ptr<LocalWatcher> localWatcher;
+};
+
+struct SyncMessage
+{
+    int icon;
+    std::string title;
+    std::string text;
+    int timeout;
+};
+
+//everything that happened since the UI thread asked the last time
+struct SyncUpdate
+{
+    std::string status;
+    int percent = 0;
+    bool busy = false;
+    std::vector<SyncMessage> messages;
+    std::vector<SyncJobResult> results;
+};
+
+class SyncWorker
+{
+    public:
+        /**
+         * Starts the thread, it uses an own connection to the DB and to the server
+         *
+         * @param dbPath path of the DB
+         */
+        SyncWorker(const std::string &dbPath);
+
+        /**
+         * Cancels the running job and waits for the thread
+         */
+        ~SyncWorker();
+
+        SyncWorker(const SyncWorker &) = delete;
+        SyncWorker &operator=(const SyncWorker &) = delete;
+
+        /**
+         * Adds a job to the end of the queue, the UI thread has to connect to the network before
+         */
+        void push(const SyncJob &job);
+
+        /**
+         * Removes the queued jobs and aborts the running one before its next chunk of data
+         */
+        void cancel();
+
+        /**
+         * Returns true if a job is running or queued
+         */
+        bool isBusy();
+
+        /**
+         * If set the worker trusts the stored state of files instead of checking the local files
+         */
+        void setLocalStatesTracked(bool tracked) { _localStatesTracked = tracked; };
+
+        /**
+         * Hands the progress, messages and finished jobs over to the UI thread, has to be called on SYNCWORKER_EVENT
+         */
+        SyncUpdate takeUpdate();
+
+    private:
+        std::string _dbPath;
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<SyncJob> _jobs;
+        bool _running = false;
+        bool _stop = false;
+        std::string _status;
+        int _percent = 0;
+        std::vector<SyncMessage> _messages;
+        std::vector<SyncJobResult> _results;
+
+        std::atomic<bool> _cancel{false};
+        std::atomic<bool> _localStatesTracked{false};
+        std::atomic<bool> _reloadWebDAV{false};
+        //set while an event is on its way to the UI thread, so that the queue of inkview is not flooded
+        std::atomic<bool> _eventPending{false};
+        int _task;
+        int _configListener = 0;
+
+        //only used by the thread
+        std::unique_ptr<WebDAV> _webDAV;
+        std::unique_ptr<SqliteConnector> _sqllite;
+        std::shared_ptr<FileHandler> _fileHandler;
+
+        void run();
+
+        /**
+         * Creates the connection to the server with the current credentials
+         */
+        void createWebDAV();
+
+        /**
+         * Sends an event to the UI thread
+         */
+        void notify();
+
+        void setStatus(const std::string &status, int percent);
+
+        void addMessage(int icon, const std::string &title, const std::string &text, int timeout);
+
+        bool listFolder(const std::string &path, SyncJobResult &result);
+
+        /**
+         * Compares the etag of a stored folder with the server using a Depth 0 request
+         * Nextcloud changes the etag of all parents of a changed item, so nothing below the folder has changed if it matches
+         *
+         * @param path folder whose children are stored
+         */
+        bool isUnchanged(const std::string &path);
+
+        bool download(WebDAVItem &item, SyncJobResult &result);
+
+        /**
+         * Downloads the queued files by priority until the queue is empty
+         * Files that fail stay queued and are tried again with the next job
+         *
+         * @param result changed is set if a file has been downloaded
+         * @return false if a file could not be downloaded
+         */
+        bool processTransfers(SyncJobResult &result);
+
+        bool reconcile(const std::string &path);
+
+        /**
+         * Uploads a local item, missing folders are created first and the items are saved with the etags of the server
+         *
+         * @param item local file or folder
+         * @param result changed is set if an item has been uploaded
+         * @return false if an item could not be uploaded
+         */
+        bool upload(const WebDAVItem &item, SyncJobResult &result);
+
+        /**
+         * Creates the item of a local file or folder as it is stored once it has been uploaded
+         *
+         * @param localPath path of the item in the storage location
+         * @param type type of the item
+         */
+        WebDAVItem createUploadItem(const std::string &localPath, Itemtype type);
+
+        /**
+         * Watches every folder below the root and stores the states of the local files found
+         *
+         * @param root storage location of the user
+         * @param result receives the started watcher
+         * @return false if not all folders are watched and changes can be missed
+         */
+        bool scanLocalFiles(const std::string &root, SyncJobResult &result);
+
+        /**
+         * Syncs the folder structure and collects the files that have to be downloaded
+         *
+         * @param items items of the current folder
+         * @param itemID item that shall be synced
+         * @param downloads files that have to be downloaded are added here
+         * @param result receives the local items that have been removed from the cloud
+         */
+        void downloadFolder(std::vector<WebDAVItem> &items, int itemID, std::vector<WebDAVItem> &downloads, SyncJobResult &result);
+
+        /**
+         * Compares the items of a folder with the stored ones and saves them
+         *
+         * @param items items of the folder, the first item is the folder itself
+         * @return true if an item has been added, removed or changed its etag or state
+         */
+        bool updateItems(std::vector<WebDAVItem> &items);
+
+        /**
+         * Applies the changes since the last stored sync-token to the DB
+         *
+         * @return false if the server does not support sync-tokens and the etags have to be compared
+         */
+        bool syncChanges();
+
+        /**
+         * Computes the states of items of a tree response from the stored ones and saves them
+         *
+         * @param items items below the root path, their parents are either stored or part of the items
+         * @param rootPath folder the items have been requested for
+         */
+        void saveTreeItems(std::vector<WebDAVItem> &items, const std::string &rootPath);
+
+        /**
+         * Stores the complete structure below the folder with as few requests as the server allows
+         * Depth: infinity is tried first, then a SEARCH and at last the folders are requested one by one
+         *
+         * @param path folder that shall be indexed
+         * @return false if the structure could not be stored completely
+         */
+        bool indexTree(const std::string &path);
+};
+#endif
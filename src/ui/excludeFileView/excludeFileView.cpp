@@ -167,8 +167,6 @@ int ExcludeFileView::excludeClicked(int x, int y)
             }
         }
 
-        FileHandler::update(_regex, _folderRegex, _extensionList, _invertMatch);
-
         return 3;
     }
     else if (IsInRect(x, y, &_cancelButton))
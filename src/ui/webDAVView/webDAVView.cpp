@@ -53,9 +53,10 @@ WebDAVView::WebDAVView(const irect &contentRect, vector<WebDAVItem> &itemsUnfilt
         begin = items.begin()+1;
     }
 
-    sort(begin, items.end(), []( WebDAVItem &w1, WebDAVItem &w2) -> bool
+    const bool sortByDate = Util::getConfig<int>("sortBy", -1) == 2;
+    sort(begin, items.end(), [sortByDate]( WebDAVItem &w1, WebDAVItem &w2) -> bool
     {
-        if(Util::getConfig<int>("sortBy", -1) == 2)
+        if(sortByDate)
         {
             //sort by lastmodified
             time_t t1 = mktime(&w1.lastEditDate);
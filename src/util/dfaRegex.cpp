@@ -0,0 +1,737 @@
+//------------------------------------------------------------------
+// dfaRegex.cpp
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+//
+//-------------------------------------------------------------------
+
+#include "dfaRegex.h"
+
+#include <string>
+#include <vector>
+#include <bitset>
+#include <map>
+#include <algorithm>
+#include <cctype>
+
+using std::string;
+using std::vector;
+
+namespace
+{
+    // limits to keep the compile time and the memory of the tables small, larger patterns use std::regex
+    const int MAX_REPEAT = 100;
+    const size_t MAX_NFA_STATES = 5000;
+    const size_t MAX_DFA_STATES = 2000;
+
+    typedef std::bitset<256> ByteSet;
+
+    struct Node
+    {
+        enum Type
+        {
+            SET,
+            CONCAT,
+            ALT,
+            REPEAT,
+            BEGIN,
+            END
+        };
+
+        Type type;
+        ByteSet set;
+        vector<Node> children;
+        int min = 0;
+        // -1 means unlimited
+        int max = 0;
+    };
+
+    /**
+     * Recursive descent parser for the supported subset of the ECMAScript syntax,
+     * throws Unsupported for everything else
+     */
+    class Parser
+    {
+        public:
+            struct Unsupported
+            {
+            };
+
+            explicit Parser(const string &pattern) : _pattern(pattern) {}
+
+            Node parse()
+            {
+                Node node = parseAlternative();
+                if (_pos != _pattern.length())
+                    throw Unsupported();
+                return node;
+            }
+
+        private:
+            const string &_pattern;
+            size_t _pos = 0;
+
+            bool atEnd() const { return _pos >= _pattern.length(); }
+            char peek() const { return _pattern[_pos]; }
+
+            static Node setNode(const ByteSet &set)
+            {
+                Node node;
+                node.type = Node::SET;
+                node.set = set;
+                return node;
+            }
+
+            static ByteSet byteSet(unsigned char c)
+            {
+                ByteSet set;
+                set.set(c);
+                return set;
+            }
+
+            static ByteSet rangeSet(unsigned char from, unsigned char to)
+            {
+                ByteSet set;
+                for (int c = from; c <= to; c++)
+                    set.set(c);
+                return set;
+            }
+
+            Node parseAlternative()
+            {
+                Node node;
+                node.type = Node::ALT;
+                node.children.push_back(parseConcat());
+                while (!atEnd() && peek() == '|')
+                {
+                    _pos++;
+                    node.children.push_back(parseConcat());
+                }
+                if (node.children.size() == 1)
+                    return node.children.front();
+                return node;
+            }
+
+            Node parseConcat()
+            {
+                Node node;
+                node.type = Node::CONCAT;
+                while (!atEnd() && peek() != '|' && peek() != ')')
+                    node.children.push_back(parseRepeat());
+                return node;
+            }
+
+            int parseNumber()
+            {
+                if (atEnd() || !isdigit(static_cast<unsigned char>(peek())))
+                    throw Unsupported();
+                int number = 0;
+                while (!atEnd() && isdigit(static_cast<unsigned char>(peek())))
+                {
+                    number = number * 10 + (peek() - '0');
+                    if (number > MAX_REPEAT)
+                        throw Unsupported();
+                    _pos++;
+                }
+                return number;
+            }
+
+            Node parseRepeat()
+            {
+                Node atom = parseAtom();
+                if (atEnd())
+                    return atom;
+
+                int min;
+                int max;
+                switch (peek())
+                {
+                    case '*':
+                        min = 0;
+                        max = -1;
+                        _pos++;
+                        break;
+                    case '+':
+                        min = 1;
+                        max = -1;
+                        _pos++;
+                        break;
+                    case '?':
+                        min = 0;
+                        max = 1;
+                        _pos++;
+                        break;
+                    case '{':
+                        _pos++;
+                        min = parseNumber();
+                        max = min;
+                        if (!atEnd() && peek() == ',')
+                        {
+                            _pos++;
+                            max = (!atEnd() && peek() == '}') ? -1 : parseNumber();
+                        }
+                        if (atEnd() || peek() != '}' || (max != -1 && max < min))
+                            throw Unsupported();
+                        _pos++;
+                        break;
+                    default:
+                        return atom;
+                }
+
+                if (atom.type == Node::BEGIN || atom.type == Node::END)
+                    throw Unsupported();
+                // lazy quantifiers do not change whether the complete text matches
+                if (!atEnd() && peek() == '?')
+                    _pos++;
+                if (!atEnd() && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{'))
+                    throw Unsupported();
+
+                Node node;
+                node.type = Node::REPEAT;
+                node.min = min;
+                node.max = max;
+                node.children.push_back(atom);
+                return node;
+            }
+
+            Node parseAtom()
+            {
+                char c = peek();
+                _pos++;
+                switch (c)
+                {
+                    case '(':
+                        {
+                            if (!atEnd() && peek() == '?')
+                            {
+                                if (_pos + 1 < _pattern.length() && _pattern[_pos + 1] == ':')
+                                    _pos += 2;
+                                else
+                                    throw Unsupported();
+                            }
+                            Node node = parseAlternative();
+                            if (atEnd() || peek() != ')')
+                                throw Unsupported();
+                            _pos++;
+                            return node;
+                        }
+                    case '[':
+                        return setNode(parseClass());
+                    case '.':
+                        {
+                            ByteSet set;
+                            set.set();
+                            set.reset('\n');
+                            set.reset('\r');
+                            return setNode(set);
+                        }
+                    case '^':
+                        {
+                            Node node;
+                            node.type = Node::BEGIN;
+                            return node;
+                        }
+                    case '$':
+                        {
+                            Node node;
+                            node.type = Node::END;
+                            return node;
+                        }
+                    case '\\':
+                        {
+                            ByteSet set;
+                            parseEscape(false, set);
+                            return setNode(set);
+                        }
+                    case ')':
+                    case '*':
+                    case '+':
+                    case '?':
+                    case '{':
+                    case '}':
+                    case ']':
+                        throw Unsupported();
+                    default:
+                        return setNode(byteSet(static_cast<unsigned char>(c)));
+                }
+            }
+
+            /**
+             * Parses the escape after a backslash
+             *
+             * @param inClass escape is part of a character class
+             * @param set receives the matched bytes
+             * @return true if the escape is a single byte, false if it is a class like \d
+             */
+            bool parseEscape(bool inClass, ByteSet &set)
+            {
+                if (atEnd())
+                    throw Unsupported();
+
+                char c = peek();
+                _pos++;
+                switch (c)
+                {
+                    case 'd':
+                    case 'D':
+                        set = rangeSet('0', '9');
+                        if (c == 'D')
+                            set.flip();
+                        return false;
+                    case 'w':
+                    case 'W':
+                        set = rangeSet('a', 'z') | rangeSet('A', 'Z') | rangeSet('0', '9') | byteSet('_');
+                        if (c == 'W')
+                            set.flip();
+                        return false;
+                    case 's':
+                    case 'S':
+                        set = byteSet(' ') | rangeSet('\t', '\r');
+                        if (c == 'S')
+                            set.flip();
+                        return false;
+                    case 't':
+                        set = byteSet('\t');
+                        return true;
+                    case 'n':
+                        set = byteSet('\n');
+                        return true;
+                    case 'r':
+                        set = byteSet('\r');
+                        return true;
+                    case 'f':
+                        set = byteSet('\f');
+                        return true;
+                    case 'v':
+                        set = byteSet('\v');
+                        return true;
+                    case 'b':
+                        if (!inClass)
+                            throw Unsupported();
+                        set = byteSet('\b');
+                        return true;
+                    case '0':
+                        if (!atEnd() && isdigit(static_cast<unsigned char>(peek())))
+                            throw Unsupported();
+                        set = byteSet('\0');
+                        return true;
+                    case 'x':
+                        {
+                            if (_pos + 2 > _pattern.length() || !isxdigit(static_cast<unsigned char>(_pattern[_pos])) || !isxdigit(static_cast<unsigned char>(_pattern[_pos + 1])))
+                                throw Unsupported();
+                            int value = std::stoi(_pattern.substr(_pos, 2), nullptr, 16);
+                            _pos += 2;
+                            set = byteSet(static_cast<unsigned char>(value));
+                            return true;
+                        }
+                    default:
+                        // backreferences, word boundaries, unicode escapes etc.
+                        if (isalnum(static_cast<unsigned char>(c)))
+                            throw Unsupported();
+                        set = byteSet(static_cast<unsigned char>(c));
+                        return true;
+                }
+            }
+
+            ByteSet parseClass()
+            {
+                ByteSet set;
+                bool negate = false;
+                if (!atEnd() && peek() == '^')
+                {
+                    negate = true;
+                    _pos++;
+                }
+                // empty classes and a leading bracket are handled differently by the implementations
+                if (atEnd() || peek() == ']')
+                    throw Unsupported();
+
+                while (!atEnd() && peek() != ']')
+                {
+                    ByteSet item;
+                    bool single = true;
+                    char c = peek();
+                    _pos++;
+                    if (c == '\\')
+                        single = parseEscape(true, item);
+                    else if (c == '[' && !atEnd() && (peek() == ':' || peek() == '.' || peek() == '='))
+                        throw Unsupported();
+                    else
+                        item = byteSet(static_cast<unsigned char>(c));
+
+                    if (!single && _pos + 1 < _pattern.length() && peek() == '-' && _pattern[_pos + 1] != ']')
+                        throw Unsupported();
+                    if (single && _pos + 1 < _pattern.length() && peek() == '-' && _pattern[_pos + 1] != ']')
+                    {
+                        _pos++;
+                        ByteSet to;
+                        char toChar = peek();
+                        _pos++;
+                        if (toChar == '\\')
+                        {
+                            if (!parseEscape(true, to))
+                                throw Unsupported();
+                        }
+                        else
+                        {
+                            to = byteSet(static_cast<unsigned char>(toChar));
+                        }
+
+                        int from = 0;
+                        int until = 0;
+                        while (!item.test(from))
+                            from++;
+                        while (!to.test(until))
+                            until++;
+                        // the order of bytes above ASCII depends on the signedness of char
+                        if (from > until || until > 127)
+                            throw Unsupported();
+                        item = rangeSet(from, until);
+                    }
+                    set |= item;
+                }
+                if (atEnd())
+                    throw Unsupported();
+                _pos++;
+
+                if (negate)
+                    set.flip();
+                return set;
+            }
+    };
+
+    struct NfaState
+    {
+        enum Type
+        {
+            EPSILON,
+            SET,
+            BEGIN,
+            END,
+            MATCH
+        };
+
+        Type type;
+        // index into the sets for SET states
+        int set = -1;
+        // successor of SET, BEGIN and END states
+        int out = -1;
+        vector<int> epsilon;
+    };
+
+    class NfaBuilder
+    {
+        public:
+            vector<NfaState> states;
+            vector<ByteSet> sets;
+
+            struct Fragment
+            {
+                int start;
+                // epsilon state without successors that has to be connected
+                int end;
+            };
+
+            int addState(NfaState::Type type)
+            {
+                if (states.size() >= MAX_NFA_STATES)
+                    throw Parser::Unsupported();
+                NfaState state;
+                state.type = type;
+                states.push_back(state);
+                return states.size() - 1;
+            }
+
+            Fragment build(const Node &node)
+            {
+                switch (node.type)
+                {
+                    case Node::SET:
+                    case Node::BEGIN:
+                    case Node::END:
+                        {
+                            int start = addState(node.type == Node::SET ? NfaState::SET : (node.type == Node::BEGIN ? NfaState::BEGIN : NfaState::END));
+                            int end = addState(NfaState::EPSILON);
+                            states[start].out = end;
+                            if (node.type == Node::SET)
+                            {
+                                auto found = std::find(sets.begin(), sets.end(), node.set);
+                                states[start].set = found - sets.begin();
+                                if (found == sets.end())
+                                    sets.push_back(node.set);
+                            }
+                            return {start, end};
+                        }
+                    case Node::CONCAT:
+                        {
+                            int start = addState(NfaState::EPSILON);
+                            int end = start;
+                            for (const auto &child : node.children)
+                            {
+                                Fragment fragment = build(child);
+                                states[end].epsilon.push_back(fragment.start);
+                                end = fragment.end;
+                            }
+                            return {start, end};
+                        }
+                    case Node::ALT:
+                        {
+                            int start = addState(NfaState::EPSILON);
+                            int end = addState(NfaState::EPSILON);
+                            for (const auto &child : node.children)
+                            {
+                                Fragment fragment = build(child);
+                                states[start].epsilon.push_back(fragment.start);
+                                states[fragment.end].epsilon.push_back(end);
+                            }
+                            return {start, end};
+                        }
+                    case Node::REPEAT:
+                        {
+                            const Node &child = node.children.front();
+                            int start = addState(NfaState::EPSILON);
+                            int end = start;
+                            for (int i = 0; i < node.min; i++)
+                            {
+                                Fragment fragment = build(child);
+                                states[end].epsilon.push_back(fragment.start);
+                                end = fragment.end;
+                            }
+                            if (node.max == -1)
+                            {
+                                Fragment fragment = build(child);
+                                int loopEnd = addState(NfaState::EPSILON);
+                                states[end].epsilon.push_back(fragment.start);
+                                states[end].epsilon.push_back(loopEnd);
+                                states[fragment.end].epsilon.push_back(end);
+                                end = loopEnd;
+                            }
+                            else
+                            {
+                                int optionalEnd = addState(NfaState::EPSILON);
+                                for (int i = node.min; i < node.max; i++)
+                                {
+                                    Fragment fragment = build(child);
+                                    states[end].epsilon.push_back(fragment.start);
+                                    states[end].epsilon.push_back(optionalEnd);
+                                    end = fragment.end;
+                                }
+                                states[end].epsilon.push_back(optionalEnd);
+                                end = optionalEnd;
+                            }
+                            return {start, end};
+                        }
+                }
+                throw Parser::Unsupported();
+            }
+
+            /**
+             * Returns the sorted states reachable from the seeds without consuming a byte
+             *
+             * @param atBegin assertions for the begin of the text can be passed
+             * @param atEnd assertions for the end of the text can be passed
+             */
+            vector<int> closure(const vector<int> &seeds, bool atBegin, bool atEnd) const
+            {
+                vector<char> visited(states.size(), 0);
+                vector<int> stack(seeds);
+                vector<int> result;
+                while (!stack.empty())
+                {
+                    int current = stack.back();
+                    stack.pop_back();
+                    if (visited[current])
+                        continue;
+                    visited[current] = 1;
+
+                    const NfaState &state = states[current];
+                    switch (state.type)
+                    {
+                        case NfaState::EPSILON:
+                            stack.insert(stack.end(), state.epsilon.begin(), state.epsilon.end());
+                            break;
+                        case NfaState::BEGIN:
+                            result.push_back(current);
+                            if (atBegin)
+                                stack.push_back(state.out);
+                            break;
+                        case NfaState::END:
+                            result.push_back(current);
+                            if (atEnd)
+                                stack.push_back(state.out);
+                            break;
+                        default:
+                            result.push_back(current);
+                            break;
+                    }
+                }
+                std::sort(result.begin(), result.end());
+                return result;
+            }
+
+            bool accepts(const vector<int> &stateSet) const
+            {
+                for (int state : closure(stateSet, false, true))
+                {
+                    if (states[state].type == NfaState::MATCH)
+                        return true;
+                }
+                return false;
+            }
+    };
+
+    /**
+     * Collects the text every match has to begin with
+     *
+     * @return true if the pattern consists only of that text
+     */
+    bool literalPrefix(const Node &node, string &prefix)
+    {
+        if (node.type == Node::SET)
+        {
+            if (node.set.count() != 1)
+                return false;
+            for (int c = 0; c < 256; c++)
+            {
+                if (node.set.test(c))
+                    prefix.push_back(static_cast<char>(c));
+            }
+            return true;
+        }
+        if (node.type != Node::CONCAT)
+            return false;
+
+        size_t i = 0;
+        while (i < node.children.size() && node.children[i].type == Node::BEGIN)
+            i++;
+        for (; i < node.children.size(); i++)
+        {
+            const Node &child = node.children[i];
+            if (child.type != Node::SET || child.set.count() != 1)
+                break;
+            literalPrefix(child, prefix);
+        }
+        while (i < node.children.size() && node.children[i].type == Node::END)
+            i++;
+        return i == node.children.size();
+    }
+}
+
+DfaRegex::DfaRegex(const string &pattern)
+{
+    if (!compile(pattern))
+        _fallback = std::make_shared<std::regex>(pattern);
+}
+
+bool DfaRegex::compile(const string &pattern)
+{
+    Node root;
+    NfaBuilder nfa;
+    NfaBuilder::Fragment fragment;
+    try
+    {
+        root = Parser(pattern).parse();
+        fragment = nfa.build(root);
+    }
+    catch (const Parser::Unsupported &)
+    {
+        return false;
+    }
+    int match = nfa.addState(NfaState::MATCH);
+    nfa.states[fragment.end].epsilon.push_back(match);
+
+    // bytes that are contained in the same sets behave equally and share one column
+    std::map<vector<bool>, int> classes;
+    for (int c = 0; c < 256; c++)
+    {
+        vector<bool> signature(nfa.sets.size());
+        for (size_t i = 0; i < nfa.sets.size(); i++)
+            signature[i] = nfa.sets[i].test(c);
+        auto inserted = classes.emplace(signature, classes.size());
+        _byteClass[c] = inserted.first->second;
+    }
+    _classCount = classes.size();
+    vector<int> representative(_classCount);
+    for (int c = 255; c >= 0; c--)
+        representative[_byteClass[c]] = c;
+
+    // subset construction of all reachable states
+    std::map<vector<int>, int> ids;
+    vector<vector<int>> pending;
+    auto addDfaState = [&](const vector<int> &stateSet) -> int {
+        auto found = ids.find(stateSet);
+        if (found != ids.end())
+            return found->second;
+        int id = ids.size();
+        ids.emplace(stateSet, id);
+        pending.push_back(stateSet);
+        _accepting.push_back(nfa.accepts(stateSet));
+        _transitions.resize(_transitions.size() + _classCount, -1);
+        return id;
+    };
+
+    // the empty text is the only one where assertions for the begin and the end apply at the same time
+    _emptyMatch = nfa.accepts(nfa.closure({fragment.start}, true, true));
+    _startState = addDfaState(nfa.closure({fragment.start}, true, false));
+    for (size_t current = 0; current < pending.size(); current++)
+    {
+        if (pending.size() > MAX_DFA_STATES)
+        {
+            _transitions.clear();
+            _accepting.clear();
+            return false;
+        }
+        for (int byteClass = 0; byteClass < _classCount; byteClass++)
+        {
+            vector<int> next;
+            for (int state : pending[current])
+            {
+                const NfaState &nfaState = nfa.states[state];
+                if (nfaState.type == NfaState::SET && nfa.sets[nfaState.set].test(representative[byteClass]))
+                    next.push_back(nfaState.out);
+            }
+            if (next.empty())
+                continue;
+            vector<int> nextSet = nfa.closure(next, false, false);
+            int target = addDfaState(nextSet);
+            _transitions[current * _classCount + byteClass] = target;
+        }
+    }
+
+    _literal = literalPrefix(root, _literalPrefix);
+    _afterPrefixState = _startState;
+    for (char c : _literalPrefix)
+    {
+        _afterPrefixState = _transitions[_afterPrefixState * _classCount + _byteClass[static_cast<unsigned char>(c)]];
+        if (_afterPrefixState < 0)
+            break;
+    }
+
+    return true;
+}
+
+bool DfaRegex::match(const string &text) const
+{
+    if (_fallback)
+        return std::regex_match(text, *_fallback);
+    if (_startState < 0)
+        return false;
+
+    if (_literal)
+        return text == _literalPrefix;
+    if (text.empty())
+        return _emptyMatch;
+    if (text.compare(0, _literalPrefix.length(), _literalPrefix) != 0)
+        return false;
+
+    int state = _afterPrefixState;
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(text.data());
+    for (size_t i = _literalPrefix.length(); i < text.length(); i++)
+    {
+        if (state < 0)
+            return false;
+        state = _transitions[state * _classCount + _byteClass[data[i]]];
+    }
+    return state >= 0 && _accepting[state];
+}
@@ -0,0 +1,70 @@
+//------------------------------------------------------------------
+// dfaRegex.h
+//
+// Author:           JuanJakobo
+// Date:             17.10.2026
+// Description: Regex that is compiled into a DFA to match names without backtracking
+//
+//-------------------------------------------------------------------
+
+#ifndef DFAREGEX
+#define DFAREGEX
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <regex>
+
+class DfaRegex
+{
+    public:
+        DfaRegex() = default;
+
+        /**
+         * Compiles an ECMAScript pattern into a DFA
+         * Patterns that use features the DFA cannot express (e.g. backreferences, lookaheads)
+         * are handed to std::regex
+         *
+         * @param pattern regex that has to match the complete text
+         * @throws std::regex_error if the pattern is invalid
+         */
+        explicit DfaRegex(const std::string &pattern);
+
+        /**
+         * Checks if the complete text matches the pattern (like std::regex_match)
+         *
+         * @param text text that shall be checked
+         */
+        bool match(const std::string &text) const;
+
+        /**
+         * Returns true if the pattern could not be compiled into a DFA and std::regex is used
+         */
+        bool usesFallback() const { return _fallback != nullptr; };
+
+    private:
+        // transitions of all states, the row of a state has one entry per byte class, -1 means no match possible
+        std::vector<int> _transitions;
+        std::vector<char> _accepting;
+        std::array<unsigned char, 256> _byteClass{};
+        int _classCount = 0;
+        int _startState = -1;
+        bool _emptyMatch = false;
+
+        // every match begins with this text, the DFA continues at the state reached after it
+        std::string _literalPrefix;
+        int _afterPrefixState = -1;
+        // the pattern is only a literal text
+        bool _literal = false;
+
+        std::shared_ptr<std::regex> _fallback;
+
+        /**
+         * Builds the DFA
+         *
+         * @return false if the pattern is not supported by the DFA
+         */
+        bool compile(const std::string &pattern);
+};
+#endif
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <fstream>
+#include <mutex>
 
 void Log::writeInfoLog(const std::string &text)
 {
@@ -24,6 +25,10 @@ void Log::writeErrorLog(const std::string &text)
 
 void Log::writeLog(const std::string &text)
 {
+    //the sync worker writes from its own thread
+    static std::mutex logMutex;
+    std::lock_guard<std::mutex> guard(logMutex);
+
     std::ofstream log(CONFIG_FOLDER + std::string("/logfile.txt"), std::ios_base::app | std::ios_base::out);
 
     time_t rawtime;
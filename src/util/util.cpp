@@ -17,6 +17,8 @@
 #include <iomanip>
 
 #include <signal.h>
+#include <vector>
+#include <utility>
 
 pid_t child_pid = -1; //Global
 
@@ -34,6 +36,84 @@ size_t Util::writeData(void *ptr, size_t size, size_t nmemb, FILE *stream)
     return written;
 }
 
+namespace
+{
+    iconfig *config = nullptr;
+
+    //function local so that handlers created during static initialization can register
+    std::vector<std::pair<int, std::function<void(const string &)>>> &configListeners()
+    {
+        static std::vector<std::pair<int, std::function<void(const string &)>>> listeners;
+        return listeners;
+    }
+
+    std::mutex &listenersMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+}
+
+std::mutex &Util::configMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+iconfig *Util::getConfigHandle()
+{
+    if (config == nullptr)
+    {
+        iconfigedit *temp = nullptr;
+        config = OpenConfig(CONFIG_PATH.c_str(), temp);
+    }
+    return config;
+}
+
+void Util::resetConfig()
+{
+    std::lock_guard<std::mutex> guard(configMutex());
+    if (config != nullptr)
+    {
+        CloseConfigNoSave(config);
+        config = nullptr;
+    }
+}
+
+int Util::addConfigListener(std::function<void(const string &name)> listener)
+{
+    static int nextId = 0;
+    std::lock_guard<std::mutex> guard(listenersMutex());
+    configListeners().emplace_back(++nextId, listener);
+    return nextId;
+}
+
+void Util::removeConfigListener(int id)
+{
+    std::lock_guard<std::mutex> guard(listenersMutex());
+    auto &listeners = configListeners();
+    for (auto it = listeners.begin(); it != listeners.end(); ++it)
+    {
+        if (it->first == id)
+        {
+            listeners.erase(it);
+            return;
+        }
+    }
+}
+
+void Util::notifyConfigListeners(const string &name)
+{
+    //copied as a listener may remove itself
+    std::vector<std::pair<int, std::function<void(const string &)>>> listeners;
+    {
+        std::lock_guard<std::mutex> guard(listenersMutex());
+        listeners = configListeners();
+    }
+    for (const auto &listener : listeners)
+        listener.second(name);
+}
+
 //https://github.com/pmartin/pocketbook-demo/blob/master/devutils/wifi.cpp
 bool Util::connectToNetwork()
 {
@@ -112,6 +192,54 @@ void Util::encodeUrl(string &text)
     curl_easy_cleanup(curl);
 }
 
+void Util::encodeXml(string &text)
+{
+    string encoded;
+    encoded.reserve(text.length());
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                encoded += "&amp;";
+                break;
+            case '<':
+                encoded += "&lt;";
+                break;
+            case '>':
+                encoded += "&gt;";
+                break;
+            case '"':
+                encoded += "&quot;";
+                break;
+            case '\'':
+                encoded += "&apos;";
+                break;
+            default:
+                encoded += c;
+        }
+    }
+    text = encoded;
+}
+
+void Util::decodeXml(string &text)
+{
+    const std::pair<string, char> entities[] = {{"&quot;", '"'}, {"&apos;", '\''}, {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}};
+    size_t found = text.find('&');
+    while (found != string::npos)
+    {
+        for (const auto &entity : entities)
+        {
+            if (text.compare(found, entity.first.length(), entity.first) == 0)
+            {
+                text.replace(found, entity.first.length(), 1, entity.second);
+                break;
+            }
+        }
+        found = text.find('&', found + 1);
+    }
+}
+
 void kill_child(int sig)
 {
     //SIGKILL
@@ -14,6 +14,8 @@
 
 #include "log.h"
 #include <string>
+#include <functional>
+#include <mutex>
 
 using std::string;
 
@@ -42,7 +44,7 @@ public:
     static bool connectToNetwork();
 
     /**
-     * Writes a value to the config
+     * Writes a value to the config and saves it if it has changed
      * T defines the type of the item (e.g. int, string etc.)
      *
      * @param name of the requested item
@@ -52,25 +54,39 @@ public:
     template <typename T>
     static void writeConfig(const std::string &name, T value, bool secret = false)
     {
-        iconfigedit *temp = nullptr;
-        iconfig *config = OpenConfig(CONFIG_PATH.c_str(), temp);
-
-        if constexpr(std::is_same<T, std::string>::value)
-        {
-            if (secret) 
-                WriteSecret(config, name.c_str(), value.c_str());
-            else 
-                WriteString(config, name.c_str(), value.c_str());
-        }
-        else if constexpr(std::is_same<T, int>::value)
         {
-            WriteInt(config, name.c_str(), value);
+            std::lock_guard<std::mutex> guard(configMutex());
+            iconfig *config = getConfigHandle();
+
+            if constexpr(std::is_same<T, std::string>::value)
+            {
+                if (secret)
+                {
+                    if (value.compare(ReadSecret(config, name.c_str(), "")) == 0)
+                        return;
+                    WriteSecret(config, name.c_str(), value.c_str());
+                }
+                else
+                {
+                    if (ReadString(config, name.c_str(), nullptr) != nullptr && value.compare(ReadString(config, name.c_str(), "")) == 0)
+                        return;
+                    WriteString(config, name.c_str(), value.c_str());
+                }
+            }
+            else if constexpr(std::is_same<T, int>::value)
+            {
+                if (ReadString(config, name.c_str(), nullptr) != nullptr && ReadInt(config, name.c_str(), 0) == value)
+                    return;
+                WriteInt(config, name.c_str(), value);
+            }
+            SaveConfig(config);
         }
-        CloseConfig(config);
+        //called without the lock as listeners may read the config
+        notifyConfigListeners(name);
     }
 
     /**
-     * Reads the value from the config file
+     * Reads the value from the config that is kept in memory
      * T defines the type of the item (e.g. int, string etc.)
      *
      * @param name of the requested item
@@ -80,10 +96,10 @@ public:
      * @return value from config
      */
     template <typename T>
-    static T getConfig(string name, T defaultValue = "error", bool secret = false)
+    static T getConfig(const string &name, T defaultValue = "error", bool secret = false)
     {
-        iconfigedit *temp = nullptr;
-        iconfig *config = OpenConfig(CONFIG_PATH.c_str(), temp);
+        std::lock_guard<std::mutex> guard(configMutex());
+        iconfig *config = getConfigHandle();
         T returnValue;
 
         if constexpr(std::is_same<T, std::string>::value)
@@ -97,11 +113,25 @@ public:
         {
             returnValue = ReadInt(config, name.c_str(), defaultValue);
         }
-        CloseConfig(config);
 
         return returnValue;
     }
 
+    /**
+     * Drops the config kept in memory, the next access loads it again from the file
+     */
+    static void resetConfig();
+
+    /**
+     * Registers a function that is called after a config entry has been changed
+     *
+     * @param listener receives the name of the changed entry
+     * @return id to remove the listener
+     */
+    static int addConfigListener(std::function<void(const std::string &name)> listener);
+
+    static void removeConfigListener(int id);
+
     /**
     * Returns an integer representing the download progress
     *
@@ -127,6 +157,20 @@ public:
      */
     static void encodeUrl(std::string &text);
 
+    /**
+     * Escapes the characters that are not allowed inside XML text
+     *
+     * @param text text that shall be converted
+     */
+    static void encodeXml(std::string &text);
+
+    /**
+     * Replaces the predefined XML entities by their characters
+     *
+     * @param text text that shall be converted
+     */
+    static void decodeXml(std::string &text);
+
     /**
      * Updates the library of the Pocketbook
      *
@@ -153,5 +197,17 @@ public:
 
 private:
     Util() {}
+
+    /**
+     * Returns the config, it is only parsed at the first call
+     */
+    static iconfig *getConfigHandle();
+
+    /**
+     * Guards the config handle as it is also read by the sync worker
+     */
+    static std::mutex &configMutex();
+
+    static void notifyConfigListeners(const std::string &name);
 };
 #endif